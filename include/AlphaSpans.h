@@ -0,0 +1,42 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// A run of opaque pixels on one row, covering [left, right)
+struct AlphaSpan {
+	unsigned int left;
+	unsigned int right;
+};
+
+class AlphaSpans;
+
+// A set of spans placed at an offset when composing
+struct AlphaSpansLayer {
+	const AlphaSpans* spans;
+	int x;
+	int y;
+};
+
+// The opaque runs of an image row by row. This is what the window shape is built from
+class AlphaSpans {
+public:
+	AlphaSpans(unsigned int width = 0);
+	static AlphaSpans fromImage(const sf::Image& image);
+	static AlphaSpans fromPixels(const std::uint8_t* pixels, unsigned int width, unsigned int height, unsigned int stride);
+	static AlphaSpans compose(unsigned int width, unsigned int height, const std::vector<AlphaSpansLayer>& layers);
+	AlphaSpans crop(const sf::IntRect& rect) const;
+	void addRow();
+	void addSpan(unsigned int left, unsigned int right);
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	size_t getSpanCount() const;
+	const AlphaSpan* rowBegin(unsigned int y) const;
+	const AlphaSpan* rowEnd(unsigned int y) const;
+private:
+	unsigned int _width = 0;
+	std::vector<AlphaSpan> _spans;
+	// Index of the first span of each row, plus one past the end of the last row
+	std::vector<size_t> _rows;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include <AmbientSource.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Mixes any number of looping ambient layers into a single stereo stream that plays
+// alongside the music. Every layer shares this one stream rather than each getting a
+// sound of its own, and gain changes crossfade over a given time
+class AmbientMixer : public sf::SoundStream {
+public:
+	AmbientMixer(unsigned int sampleRate = 44100);
+	~AmbientMixer() override;
+	size_t addLayer(std::unique_ptr<AmbientSource> source, float gain = 0);
+	void setGain(size_t layer, float gain, sf::Time fade = sf::seconds(1));
+	bool isAudible();
+	unsigned int getMixSampleRate() const;
+protected:
+	bool onGetData(Chunk& data) override;
+	void onSeek(sf::Time timeOffset) override;
+private:
+	struct Layer {
+		std::unique_ptr<AmbientSource> source;
+		float gain;
+		float target;
+		// Gain change per frame while fading
+		float step;
+	};
+	std::mutex _mutex;
+	std::vector<Layer> _layers;
+	unsigned int _sampleRate;
+	std::vector<float> _mix;
+	std::vector<float> _layerBuffer;
+	std::vector<std::int16_t> _buffer;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A never ending source of interleaved stereo float samples for the ambient mixer
+class AmbientSource {
+public:
+	virtual ~AmbientSource() {}
+	// Fills out with exactly frames stereo frames
+	virtual void read(float* out, size_t frames) = 0;
+};
+
+// Loops a sound file. The whole file is decoded up front so the audio thread never
+// touches the disk, which keeps this to short loops
+class AmbientFileSource : public AmbientSource {
+public:
+	bool open(const std::string& path, unsigned int sampleRate);
+	void read(float* out, size_t frames) override;
+private:
+	std::vector<float> _samples;
+	size_t _position = 0;
+};
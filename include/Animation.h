@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Plays frames from a sprite sheet on a sprite by changing its texture rect. Frames are
+// laid out left to right and then top to bottom within the sheet, and each has its own
+// duration. Time advances in fixed steps so frames land the same way whatever the frame
+// rate or however long the window slept. The alpha spans of every frame are worked out
+// up front, so the scene builds the window shape from cache when the frame changes
+class Animation {
+public:
+	Animation(sf::Sprite* sprite, const sf::IntRect& sheet, sf::Vector2i frameSize, const std::vector<sf::Time>& durations, bool looping = true);
+	void play();
+	void stop();
+	bool isPlaying() const;
+	// Returns whether the frame changed
+	bool update(sf::Time elapsed);
+	// Jumps to a point in the animation from 0 for the start up to 1 for the end, for
+	// keeping it in time with something else such as the beat of the music
+	bool setProgress(float progress);
+	size_t getFrame() const;
+	size_t getFrameCount() const;
+	// How long until the frame next changes while playing, to know how long to sleep for
+	sf::Time getTimeToNextFrame() const;
+	// Where the frame after the current one starts, from 0 up to 1 for the end, to know how
+	// long to sleep for while following something else with setProgress
+	float getNextFrameProgress() const;
+private:
+	bool _setFrame(size_t frame);
+	sf::Sprite* _sprite;
+	std::vector<sf::IntRect> _rects;
+	// Durations in steps
+	std::vector<std::int64_t> _durations;
+	std::int64_t _length = 0;
+	bool _looping;
+	bool _playing = false;
+	size_t _frame = 0;
+	// Steps spent in the current frame
+	std::int64_t _position = 0;
+	// Time not yet made up into a whole step, in microseconds
+	std::int64_t _accumulator = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorised inner loops for the audio paths, picked at runtime like the alpha scanner:
+// AVX where the CPU has it, SSE2 otherwise and plain loops everywhere else
+class AudioKernels {
+public:
+	// out += in * gain for interleaved stereo, with the gain moving by gainStep each frame
+	static void mixStereo(float* out, const float* in, size_t frames, float gain, float gainStep);
+	// Converts [-1, 1] floats to 16 bit samples, clipping anything outside of that
+	static void toInt16(std::int16_t* out, const float* in, size_t count);
+	// Converts 16 bit samples to [-1, 1) floats
+	static void toFloat(float* out, const std::int16_t* in, size_t count);
+	// samples *= gain, saturating at the ends of the 16 bit range
+	static void scaleInt16(std::int16_t* samples, size_t count, float gain);
+	// out += in * gain
+	static void multiplyAdd(float* out, const float* in, size_t count, float gain);
+	static float sumSquares(const float* in, size_t count);
+	static float maxAbs(const float* in, size_t count);
+};
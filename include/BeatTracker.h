@@ -0,0 +1,37 @@
+#pragma once
+
+#include <RealFFT.h>
+#include <vector>
+
+// Estimates the tempo of a track and where its beats fall, fed the decoded samples block
+// by block. Onsets come from the spectral flux between overlapping frames, measured
+// against the average over a sliding window, and the tempo is the strongest repeat in
+// them found by autocorrelation. Meant to be run once per track with the results cached,
+// so playback only ever needs getPhase
+class BeatTracker {
+public:
+	BeatTracker();
+	void reset(unsigned int sampleRate);
+	// Interleaved samples
+	void process(const float* samples, size_t frames, unsigned int channels);
+	// Beats per minute and the time of the first beat in seconds. Fails for tracks too
+	// short or too quiet to tell
+	bool finish(float& tempo, float& offset);
+	// How far through the current beat a time in the track is, from 0 up to 1
+	static float getPhase(float tempo, float offset, float seconds);
+private:
+	void _frame();
+	RealFFT _fft;
+	unsigned int _sampleRate = 0;
+	std::vector<float> _window;
+	// Mono samples for the next frame
+	std::vector<float> _samples;
+	size_t _filled = 0;
+	std::vector<float> _windowed;
+	std::vector<float> _re;
+	std::vector<float> _im;
+	std::vector<float> _magnitudes;
+	std::vector<float> _previous;
+	// Flux of each frame, one per hop
+	std::vector<float> _flux;
+};
@@ -6,11 +6,14 @@
 class Button {
 public:
 	Button(std::string path, float x, float y, int width = 0, int height = 0);
+	~Button();
 	bool pressed(const sf::Event::MouseButtonPressed* mouseButtonPressed, sf::Window* window);
 	void draw(sf::RenderWindow* window);
 	void draw(sf::RenderTexture* rt);
 	void setText(std::string text, sf::Font* font);
 	void setTextOffset(int x, int y = 0);
+	sf::Sprite* getSprite();
+	sf::Text* getText();
 private:
 	sf::Sprite* _sprite = NULL;
 	sf::Text* _text = NULL;
@@ -1,11 +1,38 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <AlphaSpans.h>
+#include <TextureAtlas.h>
 #include <map>
+#include <tuple>
 
+// Path keyed texture cache. Every getTexture or createSprite call holds a reference on the
+// texture until it is given back with releaseTexture or destroySprite, and textures are
+// only freed by evictUnused once nothing references them.
+// Sprites for images in the atlas all share the atlas texture
 class GraphicsManager {
 public:
+    static bool loadAtlas(const std::vector<std::string>& names);
     static sf::Texture* getTexture(std::string path);
+    // Area an image takes up in the texture its sprites use, which is part of the atlas
+    // for images packed into it
+    static sf::IntRect getRect(std::string path);
+    static void releaseTexture(const sf::Texture* texture);
+    static unsigned int evictUnused();
     static sf::Sprite* createSprite(std::string path, float x, float y, int width = 0, int height = 0);
+    static void destroySprite(sf::Sprite* sprite);
+    static const AlphaSpans& getSpans(const sf::Texture* texture);
+    static const AlphaSpans& getSpans(const sf::Texture* texture, const sf::IntRect& rect);
+private:
+    struct TextureEntry {
+        sf::Texture* texture;
+        unsigned int references;
+    };
+    static sf::Texture* _acquire(const std::string& key);
+    static sf::Texture* _insert(const std::string& key, const sf::Image& image);
+    static std::map<std::string, TextureEntry> _textureCache;
+    static TextureAtlas _atlas;
+    static std::map<const sf::Texture*, AlphaSpans> _spanCache;
+    static std::map<std::tuple<const sf::Texture*, int, int, int, int>, AlphaSpans> _rectSpanCache;
 };
 
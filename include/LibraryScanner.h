@@ -0,0 +1,22 @@
+#pragma once
+
+#include <MetadataCache.h>
+#include <TrackInfo.h>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Finds every audio file under a folder. Each subdirectory is walked as its own job on a
+// thread pool and files are probed in parallel, with results cached between runs so a
+// rescan only opens files that have changed
+class LibraryScanner {
+public:
+	// Tracks sorted by path. Blocks, so run it off the main thread
+	static std::vector<TrackInfo> scan(const std::string& directory, MetadataCache& cache);
+	static bool isAudioFile(const std::string& path);
+	static bool probe(const std::string& path, TrackInfo& info);
+private:
+	static void _walk(const std::string& directory, ThreadPool& pool, MetadataCache& cache, std::vector<TrackInfo>& tracks, std::mutex& mutex);
+	static void _readId3(const std::string& path, TrackInfo& info);
+};
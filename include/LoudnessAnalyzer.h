@@ -0,0 +1,16 @@
+#pragma once
+
+#include <BeatTracker.h>
+#include <atomic>
+#include <string>
+
+// Measures a track the way EBU R128 does: integrated loudness from K-weighted, gated
+// 400ms blocks, and true peak from the signal oversampled four times
+class LoudnessAnalyzer {
+public:
+	// LUFS, and peak as a linear sample value. Stops early and fails if cancel gets set.
+	// The decoded samples are fed to beats as well if given, so both come from one decode
+	static bool analyze(const std::string& path, float& loudness, float& peak, const std::atomic<bool>* cancel = NULL, BeatTracker* beats = NULL);
+	// Gain to bring a track to the target loudness, lowered if needed so its peak does not clip
+	static float getGain(float loudness, float peak, float target);
+};
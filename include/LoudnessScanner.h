@@ -0,0 +1,38 @@
+#pragma once
+
+#include <MetadataCache.h>
+#include <ThreadPool.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+
+// Measures the loudness and finds the beat of tracks in the background on low priority
+// threads, skipping any already in the cache. Each result is saved as it comes in, so a
+// large library is worked through a bit at a time across runs
+class LoudnessScanner {
+public:
+	// Zero threads means half the hardware threads
+	LoudnessScanner(MetadataCache& cache, unsigned int threads = 0);
+	~LoudnessScanner();
+	void add(const std::string& path);
+	// Gain for path to play at the target loudness, 1 if it has not been measured yet
+	float getGain(const std::string& path, float target);
+	// Fails if path has not been analysed yet or has no steady beat
+	bool getBeat(const std::string& path, float& tempo, float& offset);
+	// Whether any track has been analysed since the last call, so lookups that failed are
+	// only worth trying again once this returns true
+	bool pollAnalysed();
+private:
+	void _work();
+	void _analyze(const std::string& path);
+	MetadataCache& _cache;
+	std::deque<std::string> _paths;
+	std::mutex _mutex;
+	std::atomic<bool> _stop{false};
+	std::atomic<bool> _analysed{false};
+	unsigned int _threads;
+	unsigned int _workers = 0;
+	size_t _unflushed = 0;
+	ThreadPool _pool;
+};
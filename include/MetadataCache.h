@@ -0,0 +1,47 @@
+#pragma once
+
+#include <TrackInfo.h>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Probed track information kept between runs in the config directory. The database is a
+// fixed layout file that is memory mapped and searched in place, so opening it parses
+// nothing. Updates go to an append log that is replayed on load and folded back into the
+// database once it grows. Safe to use from several threads at once
+class MetadataCache {
+public:
+	~MetadataCache();
+	bool load();
+	// The cached info for path, if it was probed with the same modification time and size
+	bool find(const std::string& path, std::uint64_t modified, std::uint64_t size, TrackInfo& info);
+	// Whatever is known about path, however old
+	bool find(const std::string& path, TrackInfo& info);
+	void put(const TrackInfo& info);
+	// Writes out the log, compacting it into the database if it has grown large
+	bool flush();
+	bool compact();
+	size_t size();
+	static std::string getPath();
+	static std::string getLogPath();
+private:
+	struct Header;
+	struct Record;
+	bool _find(const std::string& path, TrackInfo& info);
+	bool _findMapped(const std::string& path, TrackInfo& info);
+	bool _compact();
+	void _map();
+	void _unmap();
+	const void* _data = NULL;
+	size_t _dataSize = 0;
+	const Record* _records = NULL;
+	std::uint64_t _recordCount = 0;
+	const char* _strings = NULL;
+	std::uint64_t _stringsSize = 0;
+	// Entries from the log, which take priority over the database
+	std::unordered_map<std::string, TrackInfo> _log;
+	FILE* _logFile = NULL;
+	std::mutex _mutex;
+};
@@ -1,14 +1,27 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <AlphaSpans.h>
 #include <string>
 
 class OSInterface {
 public:
+	// How the window shape is sent to the window server. Only used on X11. Delta only sends
+	// the runs that changed since the last shape set on the window
+	enum class ShapeMode { Pixmap, Rectangles, Delta };
 	static std::string asset(std::string fileName);
 	static std::string getExecutableDir();
 	static std::string getConfigPath();
+	// Maps a whole file read only. NULL if it cannot be opened or is empty
+	static const void* mapFile(const std::string& path, size_t& size);
+	static void unmapFile(const void* data, size_t size);
+	// For background work that should never hold up the UI or audio
+	static void lowerThreadPriority();
 	static void bringWindowToTop(sf::Window* w);
+	static bool keepWindowOnTop(sf::Window* w);
 	static void cleanupWindow(sf::Window* w);
 	static bool setTransparency(sf::Window* w, const sf::Image& image);
+	static bool setTransparency(sf::Window* w, const AlphaSpans& spans);
+	static void setShapeMode(ShapeMode mode);
+	static void benchmarkTransparency(sf::Window* w, const AlphaSpans& spans, unsigned int iterations);
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compact storage for a large number of file paths. Each distinct directory is stored once
+// and each path is a directory id plus the file name's place in one shared arena, so the
+// full path is only put back together when it is needed
+class PathTable {
+public:
+	size_t add(std::string_view path);
+	std::string get(size_t index) const;
+	std::string_view getDirectory(size_t index) const;
+	std::string_view getFilename(size_t index) const;
+	size_t size() const;
+	void clear();
+private:
+	uint32_t _internDirectory(std::string_view directory);
+	struct Record {
+		uint32_t directory;
+		uint32_t offset;
+		uint32_t length;
+	};
+	std::vector<Record> _records;
+	// File names, back to back
+	std::vector<char> _names;
+	// Directories including their trailing separator
+	std::deque<std::string> _directories;
+	std::unordered_map<std::string_view, uint32_t> _directoryIds;
+	// Entries in a playlist tend to come a directory at a time
+	uint32_t _lastDirectory = UINT32_MAX;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Decides which playlist track plays next. Shuffle is a Fisher-Yates shuffle done one draw
+// at a time, with only the swapped slots stored, so nothing is done up front however long
+// the playlist is. Tracks played are kept so previous steps back through what was heard
+class PlayOrder {
+public:
+	enum class Repeat { Off, One, All };
+	static const size_t NONE = SIZE_MAX;
+	PlayOrder();
+	// Starts over with a playlist of count tracks, playing start first
+	void reset(size_t count, size_t start = 0);
+	// Tracks appended to the end of the playlist. Shuffle picks them up without starting over
+	void add(size_t count);
+	void setShuffle(bool shuffle);
+	bool getShuffle() const;
+	void setRepeat(Repeat repeat);
+	Repeat getRepeat() const;
+	size_t current() const;
+	// What advance will move to, NONE at the end of the playlist
+	size_t peekNext();
+	// The current track finished. Repeats it on repeat one. False at the end of the playlist
+	bool advance();
+	// Skip to the next track, even on repeat one
+	bool next();
+	bool previous();
+	// Play a track picked by the user
+	void jump(size_t index);
+private:
+	size_t _draw();
+	size_t _slot(size_t position);
+	size_t _slotOf(size_t track);
+	// Exchanges the tracks in two slots
+	void _swap(size_t a, size_t b);
+	void _restartShuffle();
+	size_t _count = 0;
+	bool _shuffle = false;
+	Repeat _repeat = Repeat::All;
+	// Shuffle state: slots before _drawn are the tracks already drawn this round. Every
+	// slot not in _swapped still holds its own index
+	std::unordered_map<uint32_t, uint32_t> _swapped;
+	// The other way round, the slot of every track that has moved
+	std::unordered_map<uint32_t, uint32_t> _slots;
+	size_t _drawn = 0;
+	std::mt19937 _random;
+	// Drawn by peekNext but not played yet, which may be NONE for the end of the playlist
+	bool _hasPending = false;
+	size_t _pending = NONE;
+	std::vector<uint32_t> _history;
+	size_t _position = 0;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include <RingBuffer.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams tracks one after another without a gap. A dedicated decoder thread keeps a few
+// seconds of samples ahead in a lock-free ring buffer, which the audio callback only ever
+// reads from, so slow disk reads or a blocked UI thread cannot starve the audio device.
+// The queued track is opened by the decoder thread as soon as it is queued and its
+// samples follow straight on from the last sample of the current track
+class PlaybackEngine : public sf::SoundStream {
+public:
+	PlaybackEngine();
+	~PlaybackEngine() override;
+	// Gain scales the track's samples as they are decoded, to even out loudness
+	bool open(const std::string& path, float gain = 1);
+	void queue(const std::string& path, float gain = 1);
+	bool pollTrackChanged();
+	// How far into the current track playback is. The playing offset counts from whenever
+	// the stream was opened, which may have been a few tracks back
+	sf::Time getTrackOffset();
+	// A copy of every chunk handed to the audio device, for visualising what is playing.
+	// Nothing is copied until it is enabled, and chunks are dropped rather than waited on
+	// when the reader falls behind. Only one thread may read it
+	void setTapEnabled(bool enabled);
+	size_t readTap(std::int16_t* samples, size_t count);
+	size_t getTapSize() const;
+protected:
+	bool onGetData(Chunk& data) override;
+	void onSeek(sf::Time timeOffset) override;
+private:
+	struct Track {
+		std::string path;
+		sf::InputSoundFile file;
+		float gain;
+	};
+	static std::unique_ptr<Track> _load(const std::string& path, float gain);
+	static bool _sameFormat(const Track* a, const Track* b);
+	void _decode();
+	void _pauseDecoder(std::unique_lock<std::mutex>& lock);
+	void _resumeDecoder(std::unique_lock<std::mutex>& lock);
+
+	// Owned by the decoder thread, and only touched elsewhere while it is paused
+	std::unique_ptr<Track> _current;
+	std::unique_ptr<Track> _next;
+	// Tracks moved on from whose samples may not all have played yet, oldest first, so a
+	// seek still lands in the track being heard
+	std::deque<std::unique_ptr<Track>> _spliced;
+	size_t _written = 0;
+	// The current track has been read to the end
+	bool _exhausted = false;
+
+	// Requests for the decoder thread, guarded by the mutex
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::string _queued;
+	float _queuedGain = 1;
+	unsigned int _generation = 0;
+	bool _pause = false;
+	bool _paused = false;
+	bool _quit = false;
+	std::thread _decoder;
+
+	// Shared with the audio callback without locking
+	RingBuffer<std::int16_t> _samples;
+	// Sample positions in the stream where a queued track starts
+	RingBuffer<size_t> _trackStarts;
+	std::atomic<bool> _endOfStream{true};
+	std::atomic<bool> _trackChanged{false};
+	RingBuffer<std::int16_t> _tap;
+	std::atomic<bool> _tapEnabled{false};
+	// Where the current track starts, in samples of the stream's playing offset
+	std::atomic<std::int64_t> _trackStart{0};
+
+	// Only used by the audio callback
+	size_t _played = 0;
+	// Positions counted by the engine less the stream's own count, which restarts on seeks
+	std::int64_t _base = 0;
+	std::vector<std::int16_t> _buffer;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <PathTable.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A list of tracks read from and written to m3u/m3u8 files. Saved playlists live in the
+// playlists directory under the config path
+class Playlist {
+public:
+	bool load(const std::string& path);
+	bool save(const std::string& path) const;
+	void add(std::string_view path, std::string_view title = "", int duration = -1);
+	void clear();
+	size_t size() const;
+	bool empty() const;
+	std::string getPath(size_t index) const;
+	std::string_view getTitle(size_t index) const;
+	int getDuration(size_t index) const;
+	static std::string getDirectory();
+	static bool isPlaylistFile(const std::string& path);
+	static std::string import(const std::string& path);
+private:
+	void _parseLine(const char* line, size_t length, const std::string& base);
+	PathTable _paths;
+	// From #EXTINF, empty and -1 when the playlist did not say. Titles are back to back in _titles
+	struct Info {
+		uint32_t titleOffset;
+		uint32_t titleLength;
+		int duration;
+	};
+	std::vector<Info> _info;
+	std::vector<char> _titles;
+	// Metadata from an #EXTINF line, waiting for the path it describes
+	std::string _pendingTitle;
+	int _pendingDuration = -1;
+	// Reused to join relative entries onto the playlist directory
+	std::string _scratch;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <AmbientSource.h>
+#include <cstdint>
+#include <vector>
+
+// Synthesises an ambient layer from filtered noise and random impulses instead of looping
+// a recording, so it needs no assets and never repeats. Samples are made a block at a
+// time with each step of the recipe a separate straight loop over the block
+class ProceduralSource : public AmbientSource {
+public:
+	enum class Kind { Rain, Wind, Fireplace, Snow };
+	ProceduralSource(Kind kind, unsigned int sampleRate, size_t blockSize = 256, std::uint32_t seed = 1);
+	void read(float* out, size_t frames) override;
+private:
+	// A short decaying burst of noise: a rain drop or a crackle from the fire
+	struct Impulse {
+		size_t start;
+		float amplitude;
+		float decay;
+		float pan;
+	};
+	void _generateBlock();
+	void _white(float* out);
+	void _pink(float* out, unsigned int channel);
+	void _brown(float* out, unsigned int channel);
+	void _lowpass(float* samples, unsigned int channel, float cutoff);
+	void _impulses(float rate, float minLength, float maxLength, float minAmplitude, float maxAmplitude);
+	float _random();
+	float _uniform();
+
+	Kind _kind;
+	unsigned int _sampleRate;
+	size_t _blockSize;
+	// Four independent generators so the white noise loop has no dependency between lanes
+	std::uint32_t _rng[4];
+	// Filter state per channel
+	float _pinkState[2][3] = {};
+	float _brownState[2] = {};
+	float _lowpassState[2] = {};
+	// Slow random modulation for gusts of wind and the like
+	float _modulation = 0;
+	float _modulationTarget = 0;
+	std::vector<Impulse> _active;
+	// Frames until the next impulse starts
+	double _nextImpulse = 0;
+	std::vector<float> _noise;
+	std::vector<float> _channel;
+	std::vector<float> _block;
+	size_t _blockPosition;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Forward FFT of real input with a power of two size, done as a complex FFT of half the
+// size on the even and odd samples and then split back apart. Every table and buffer is
+// made up front so transforms never allocate
+class RealFFT {
+public:
+	RealFFT(size_t size);
+	size_t getSize() const;
+	// Writes the size / 2 + 1 bins from 0Hz up to the Nyquist frequency, unscaled
+	void forward(const float* in, float* re, float* im);
+private:
+	void _butterflies();
+	size_t _size;
+	size_t _half;
+	std::vector<size_t> _reversed;
+	// Twiddles for the pass joining blocks of n sit at n - 1 so each pass reads them in order
+	std::vector<float> _twiddleRe;
+	std::vector<float> _twiddleIm;
+	// Twiddles for splitting the half size result into the real spectrum
+	std::vector<float> _splitRe;
+	std::vector<float> _splitIm;
+	std::vector<float> _re;
+	std::vector<float> _im;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread. The
+// capacity is rounded up to a power of two so positions can simply be masked, and each
+// side only ever writes its own position
+template<typename T>
+class RingBuffer {
+public:
+	RingBuffer(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+		_data.resize(size);
+		_mask = size - 1;
+	}
+
+	size_t capacity() const {
+		return _data.size();
+	}
+
+	// Items available to the consumer
+	size_t size() const {
+		return _write.load(std::memory_order_acquire) - _read.load(std::memory_order_acquire);
+	}
+
+	// Room available to the producer
+	size_t space() const {
+		return capacity() - size();
+	}
+
+	// Producer only. Returns how many items fit
+	size_t write(const T* items, size_t count) {
+		size_t write = _write.load(std::memory_order_relaxed);
+		size_t read = _read.load(std::memory_order_acquire);
+		count = std::min(count, capacity() - (write - read));
+		for (size_t i = 0; i < count; i++)
+			_data[(write + i) & _mask] = items[i];
+		_write.store(write + count, std::memory_order_release);
+		return count;
+	}
+
+	bool push(const T& item) {
+		return write(&item, 1) == 1;
+	}
+
+	// Consumer only. Returns how many items were taken
+	size_t read(T* items, size_t count) {
+		size_t read = _read.load(std::memory_order_relaxed);
+		size_t write = _write.load(std::memory_order_acquire);
+		count = std::min(count, write - read);
+		for (size_t i = 0; i < count; i++)
+			items[i] = _data[(read + i) & _mask];
+		_read.store(read + count, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer only. Looks at the oldest item without taking it
+	bool peek(T& item) const {
+		size_t read = _read.load(std::memory_order_relaxed);
+		if (read == _write.load(std::memory_order_acquire))
+			return false;
+		item = _data[read & _mask];
+		return true;
+	}
+
+	bool pop(T& item) {
+		return read(&item, 1) == 1;
+	}
+
+	// Consumer only, or when the producer is known to be idle
+	void clear() {
+		_read.store(_write.load(std::memory_order_acquire), std::memory_order_release);
+	}
+private:
+	std::vector<T> _data;
+	size_t _mask = 0;
+	// Total items ever written and read. They only grow, so the difference is the size.
+	// Kept on separate cache lines so the two threads do not contend
+	alignas(64) std::atomic<size_t> _write{0};
+	alignas(64) std::atomic<size_t> _read{0};
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <AlphaSpans.h>
+#include <cstdint>
+#include <vector>
+
+class Button;
+
+// Tracks every sprite and button in a window. The transparency mask is only rebuilt and
+// pushed to the window server when something visible changes, and the sprites are drawn
+// as one vertex array per texture that is only rebuilt when the layout changes.
+// needsRedraw lets the caller skip redrawing entirely while nothing has changed.
+// Masks for the last few layouts are kept, so animations going round their frames only
+// compose each one once
+class Scene {
+public:
+	Scene(unsigned int width, unsigned int height);
+	void add(sf::Sprite* sprite, bool visible = true);
+	void add(Button* button, bool visible = true);
+	void setVisible(sf::Sprite* sprite, bool visible);
+	void setVisible(Button* button, bool visible);
+	void invalidate();
+	void requestRedraw();
+	bool needsRedraw();
+	bool updateShape(sf::Window* window);
+	void benchmarkShape(sf::Window* window, unsigned int iterations);
+	void draw(sf::RenderTarget* target);
+private:
+	struct Node {
+		sf::Sprite* sprite;
+		Button* button;
+		bool visible;
+		// Snapshot of the state last drawn and used for the mask so changes can be detected
+		const sf::Texture* texture;
+		sf::Vector2f position;
+		sf::IntRect textureRect;
+	};
+	struct Batch {
+		const sf::Texture* texture;
+		sf::VertexArray vertices;
+	};
+	struct Mask {
+		// What was visible, where and with which texture rect
+		std::vector<std::int64_t> key;
+		AlphaSpans spans;
+	};
+	void _add(sf::Sprite* sprite, Button* button, bool visible);
+	Node* _find(sf::Sprite* sprite);
+	AlphaSpans _composeMask();
+	const AlphaSpans& _getMask();
+	void _buildBatches();
+	void _snapshot();
+	std::vector<Node> _nodes;
+	std::vector<Batch> _batches;
+	// Most recently used first
+	std::vector<Mask> _masks;
+	std::vector<std::int64_t> _maskKey;
+	unsigned int _width = 0;
+	unsigned int _height = 0;
+	bool _shapeDirty = true;
+	bool _batchesDirty = true;
+	bool _redraw = true;
+};
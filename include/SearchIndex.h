@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Trigram index for finding tracks as the user types. Each entry's text is normalised and
+// every trigram in it maps to the entries containing it, so a query only looks at entries
+// sharing its rarest trigrams rather than every string. Entries are numbered in the order
+// they were added, which for the playlist is its track index
+class SearchIndex {
+public:
+	uint32_t add(std::string_view text);
+	void clear();
+	size_t size() const;
+	// Best matches first. Entries containing every word of the query come ahead of ones
+	// that only share most of its trigrams
+	std::vector<uint32_t> search(std::string_view query, size_t maxResults) const;
+	static std::string normalise(std::string_view text);
+private:
+	struct Candidate {
+		uint32_t id;
+		int score;
+	};
+	static void _trigrams(std::string_view text, std::vector<uint32_t>& out);
+	std::string_view _text(uint32_t id) const;
+	int _score(uint32_t id, const std::vector<std::string>& words, int shared) const;
+	std::unordered_map<uint32_t, std::vector<uint32_t>> _postings;
+	// Normalised text of every entry, back to back
+	std::vector<char> _texts;
+	std::vector<uint32_t> _offsets;
+	// Scratch space for the typo fallback, kept zeroed between searches so each one only
+	// touches the entries it counted
+	mutable std::vector<uint8_t> _counts;
+	mutable std::vector<uint32_t> _counted;
+};
@@ -4,7 +4,10 @@
 class Settings {
 public:
 	Settings();
+	bool has(std::string key);
 	bool getBool(std::string key);
+	std::string getString(std::string key);
+	float getFloat(std::string key);
 private:
 	toml::value _getValue(std::string key);
 	toml::value _toml;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <PlaybackEngine.h>
+#include <RealFFT.h>
+#include <cstdint>
+#include <vector>
+
+// Turns the engine's tap into levels for a row of visualiser bars, on the UI thread so the
+// audio callback only ever copies samples. Each update takes in as much audio as played
+// over the elapsed time and transforms the latest window of it, so the bars move smoothly
+// however large the chunks the device asks for are. Bands are spaced evenly in octaves
+// and fall back slowly once the sound stops
+class SpectrumAnalyzer {
+public:
+	SpectrumAnalyzer(size_t bandCount = 16, size_t size = 2048);
+	void update(PlaybackEngine& music, sf::Time elapsed);
+	// From 0 for silence to 1 for a full scale tone
+	const std::vector<float>& getBands() const;
+	// Whether the bars are still moving and need redrawing
+	bool isActive() const;
+private:
+	void _take(const std::int16_t* samples, size_t frames, unsigned int channels);
+	void _setBands(unsigned int sampleRate);
+	void _analyze(float fall);
+	RealFFT _fft;
+	unsigned int _sampleRate = 0;
+	// Frames owed to the visualiser that have not been taken off the tap yet
+	double _due = 0;
+	// The latest window of mono samples, written round and round
+	std::vector<float> _history;
+	size_t _position = 0;
+	std::vector<float> _window;
+	std::vector<float> _windowed;
+	std::vector<float> _re;
+	std::vector<float> _im;
+	std::vector<std::int16_t> _block;
+	// Bin ranges of each band
+	std::vector<size_t> _first;
+	std::vector<size_t> _last;
+	// Boost for the higher bands, which carry less energy in most music
+	std::vector<float> _tilt;
+	// Brings a full scale tone to 0dB
+	float _scale;
+	std::vector<float> _bands;
+	bool _active = false;
+};
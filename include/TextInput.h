@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Button.h>
+#include <SFML/Graphics.hpp>
+#include <string>
+
+// Single line text field drawn over a button sprite. It takes the text entered events of
+// whichever window it is in, and shows the end of the text when it is too long to fit
+class TextInput {
+public:
+	TextInput(std::string path, float x, float y, sf::Font* font, int width = 0, int height = 0);
+	~TextInput();
+	// True if the event changed the text
+	bool handleEvent(const sf::Event& event);
+	// UTF-8
+	const std::string& getString();
+	void clear();
+	Button* getButton();
+private:
+	void _update();
+	Button* _button = NULL;
+	std::string _string;
+};
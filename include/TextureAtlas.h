@@ -0,0 +1,26 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+// Packs a set of asset images into one image so the whole scene can be drawn from a
+// single texture. The packed image and its index are cached in the config directory
+// and only rebuilt when the set of images or one of the files changes
+class TextureAtlas {
+public:
+	bool load(const std::vector<std::string>& names);
+	bool contains(const std::string& name) const;
+	sf::IntRect getRect(const std::string& name) const;
+	const sf::Image& getImage() const;
+	std::string getPath() const;
+	static sf::Vector2u pack(const std::vector<sf::Vector2u>& sizes, std::vector<sf::IntRect>& rects);
+private:
+	bool _loadCached(const std::vector<std::string>& names);
+	bool _build(const std::vector<std::string>& names);
+	void _save(const std::vector<std::string>& names);
+	std::string _indexPath() const;
+	std::map<std::string, sf::IntRect> _rects;
+	sf::Image _image;
+};
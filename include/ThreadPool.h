@@ -0,0 +1,30 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs. Jobs may queue more jobs, and wait
+// returns once the queue is empty and every worker is idle
+class ThreadPool {
+public:
+	// Zero threads means one per hardware thread. Each worker runs onStart first, to set
+	// up anything per thread
+	ThreadPool(unsigned int threads = 0, std::function<void()> onStart = NULL);
+	~ThreadPool();
+	void submit(std::function<void()> job);
+	void wait();
+	unsigned int getThreadCount() const;
+private:
+	void _work(std::function<void()> onStart);
+	std::vector<std::thread> _threads;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _jobReady;
+	std::condition_variable _idle;
+	unsigned int _busy = 0;
+	bool _stop = false;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// What the library knows about an audio file. The modification time and size tell when
+// the rest has to be probed again
+struct TrackInfo {
+	std::string path;
+	std::uint64_t modified = 0;
+	std::uint64_t size = 0;
+	// Seconds
+	float duration = 0;
+	unsigned int sampleRate = 0;
+	unsigned int channels = 0;
+	std::string title;
+	std::string artist;
+	std::string album;
+	// LUFS and linear true peak, NAN until the track has been analysed
+	float loudness = NAN;
+	float peak = NAN;
+	// Beats per minute and the time of the first beat in seconds, NAN until analysed and
+	// a tempo of 0 if no steady beat was found
+	float tempo = NAN;
+	float beatOffset = NAN;
+};
@@ -0,0 +1,215 @@
+#include <AlphaSpans.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALPHA_SPANS_X86
+#include <immintrin.h>
+#ifdef __SSE2__
+#define ALPHA_SPANS_SSE2
+#endif
+#endif
+
+// Each scanner writes one bit per pixel, set where the pixel is opaque, 32 pixels per word.
+// Bits past the end of the row are left clear
+typedef void (*AlphaScanner)(const std::uint8_t* row, unsigned int width, std::uint32_t* bits);
+
+#ifndef ALPHA_SPANS_SSE2
+static void scanScalar(const std::uint8_t* row, unsigned int width, std::uint32_t* bits) {
+	for (unsigned int x = 0; x < width; x++) {
+		if (row[x * 4 + 3] != 0)
+			bits[x / 32] |= 1u << (x % 32);
+	}
+}
+#endif
+
+#ifdef ALPHA_SPANS_SSE2
+// 16 pixels per iteration. The alpha byte is shifted down so a 32 bit compare against
+// zero finds the transparent pixels and movemask packs one bit per pixel
+static void scanSSE2(const std::uint8_t* row, unsigned int width, std::uint32_t* bits) {
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		std::uint32_t transparent = 0;
+		for (unsigned int i = 0; i < 4; i++) {
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + (x + i * 4) * 4));
+			__m128i alpha = _mm_srli_epi32(pixels, 24);
+			transparent |= (std::uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(alpha, zero))) << (i * 4);
+		}
+		bits[x / 32] |= (~transparent & 0xFFFF) << (x % 32);
+	}
+	for (; x < width; x++) {
+		if (row[x * 4 + 3] != 0)
+			bits[x / 32] |= 1u << (x % 32);
+	}
+}
+#endif
+
+#ifdef ALPHA_SPANS_X86
+// Same as the SSE2 version with 8 pixels per compare, so a full word per iteration
+__attribute__((target("avx2")))
+static void scanAVX2(const std::uint8_t* row, unsigned int width, std::uint32_t* bits) {
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		std::uint32_t transparent = 0;
+		for (unsigned int i = 0; i < 4; i++) {
+			__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + (x + i * 8) * 4));
+			__m256i alpha = _mm256_srli_epi32(pixels, 24);
+			transparent |= (std::uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(alpha, zero))) << (i * 8);
+		}
+		bits[x / 32] = ~transparent;
+	}
+	for (; x < width; x++) {
+		if (row[x * 4 + 3] != 0)
+			bits[x / 32] |= 1u << (x % 32);
+	}
+}
+#endif
+
+static AlphaScanner selectScanner() {
+#ifdef ALPHA_SPANS_X86
+	if (__builtin_cpu_supports("avx2"))
+		return scanAVX2;
+#endif
+#ifdef ALPHA_SPANS_SSE2
+	return scanSSE2;
+#else
+	return scanScalar;
+#endif
+}
+
+// Finds the first pixel at or after x whose bit equals value, or width if there is none
+static unsigned int findBit(const std::uint32_t* bits, unsigned int x, unsigned int width, bool value) {
+	while (x < width) {
+		std::uint32_t word = value ? bits[x / 32] : ~bits[x / 32];
+		word >>= x % 32;
+		if (word) {
+#ifdef __GNUC__
+			x += __builtin_ctz(word);
+#else
+			while (!(word & 1)) {
+				word >>= 1;
+				x++;
+			}
+#endif
+			return x < width ? x : width;
+		}
+		x = (x / 32 + 1) * 32;
+	}
+	return width;
+}
+
+AlphaSpans::AlphaSpans(unsigned int width) {
+	_width = width;
+	_rows.push_back(0);
+}
+
+AlphaSpans AlphaSpans::fromImage(const sf::Image& image) {
+	return fromPixels(image.getPixelsPtr(), image.getSize().x, image.getSize().y, image.getSize().x * 4);
+}
+
+AlphaSpans AlphaSpans::fromPixels(const std::uint8_t* pixels, unsigned int width, unsigned int height, unsigned int stride) {
+	static const AlphaScanner scan = selectScanner();
+	AlphaSpans spans(width);
+	std::vector<std::uint32_t> bits((width + 31) / 32);
+	for (unsigned int y = 0; y < height; y++) {
+		std::fill(bits.begin(), bits.end(), 0);
+		scan(pixels + (size_t)y * stride, width, bits.data());
+		unsigned int x = findBit(bits.data(), 0, width, true);
+		while (x < width) {
+			unsigned int right = findBit(bits.data(), x, width, false);
+			spans._spans.push_back(AlphaSpan{ x, right });
+			x = findBit(bits.data(), right, width, true);
+		}
+		spans._rows.push_back(spans._spans.size());
+	}
+	return spans;
+}
+
+AlphaSpans AlphaSpans::compose(unsigned int width, unsigned int height, const std::vector<AlphaSpansLayer>& layers) {
+	AlphaSpans result(width);
+	std::vector<AlphaSpan> row;
+	for (unsigned int y = 0; y < height; y++) {
+		result.addRow();
+
+		// Gather the runs of every layer covering this row, clipped to the result
+		row.clear();
+		for (const auto& layer : layers) {
+			int layerY = (int)y - layer.y;
+			if (layerY < 0 || layerY >= (int)layer.spans->getHeight())
+				continue;
+			for (auto span = layer.spans->rowBegin(layerY); span != layer.spans->rowEnd(layerY); span++) {
+				int left = std::max((int)span->left + layer.x, 0);
+				int right = std::min((int)span->right + layer.x, (int)width);
+				if (left < right)
+					row.push_back(AlphaSpan{ (unsigned int)left, (unsigned int)right });
+			}
+		}
+		if (row.empty())
+			continue;
+
+		// Merge overlapping and touching runs into their union
+		std::sort(row.begin(), row.end(), [](const AlphaSpan& a, const AlphaSpan& b) { return a.left < b.left; });
+		AlphaSpan current = row[0];
+		for (size_t i = 1; i < row.size(); i++) {
+			if (row[i].left <= current.right) {
+				current.right = std::max(current.right, row[i].right);
+				continue;
+			}
+			result.addSpan(current.left, current.right);
+			current = row[i];
+		}
+		result.addSpan(current.left, current.right);
+	}
+	return result;
+}
+
+AlphaSpans AlphaSpans::crop(const sf::IntRect& rect) const {
+	// Anything outside of these spans is treated as transparent
+	assert(rect.size.x >= 0 && rect.size.y >= 0);
+	AlphaSpans result(rect.size.x);
+	for (int y = 0; y < rect.size.y; y++) {
+		result.addRow();
+		int sourceY = rect.position.y + y;
+		if (sourceY < 0 || sourceY >= (int)getHeight())
+			continue;
+		for (auto span = rowBegin(sourceY); span != rowEnd(sourceY); span++) {
+			int left = std::max((int)span->left - rect.position.x, 0);
+			int right = std::min((int)span->right - rect.position.x, rect.size.x);
+			if (left < right)
+				result.addSpan(left, right);
+		}
+	}
+	return result;
+}
+
+void AlphaSpans::addRow() {
+	_rows.push_back(_spans.size());
+}
+
+void AlphaSpans::addSpan(unsigned int left, unsigned int right) {
+	// Spans are added to the row most recently started with addRow
+	assert(_rows.size() > 1 && left < right && right <= _width);
+	_spans.push_back(AlphaSpan{ left, right });
+	_rows.back() = _spans.size();
+}
+
+unsigned int AlphaSpans::getWidth() const {
+	return _width;
+}
+
+unsigned int AlphaSpans::getHeight() const {
+	return _rows.size() - 1;
+}
+
+size_t AlphaSpans::getSpanCount() const {
+	return _spans.size();
+}
+
+const AlphaSpan* AlphaSpans::rowBegin(unsigned int y) const {
+	return _spans.data() + _rows[y];
+}
+
+const AlphaSpan* AlphaSpans::rowEnd(unsigned int y) const {
+	return _spans.data() + _rows[y + 1];
+}
@@ -0,0 +1,85 @@
+#include <AmbientMixer.h>
+#include <AudioKernels.h>
+#include <algorithm>
+#include <cmath>
+
+// About 50ms per chunk at 44.1kHz
+static const size_t MIX_FRAMES = 2048;
+
+AmbientMixer::AmbientMixer(unsigned int sampleRate) {
+	_sampleRate = sampleRate;
+	_mix.resize(MIX_FRAMES * 2);
+	_layerBuffer.resize(MIX_FRAMES * 2);
+	_buffer.resize(MIX_FRAMES * 2);
+	initialize(2, sampleRate, { sf::SoundChannel::FrontLeft, sf::SoundChannel::FrontRight });
+}
+
+AmbientMixer::~AmbientMixer() {
+	stop();
+}
+
+size_t AmbientMixer::addLayer(std::unique_ptr<AmbientSource> source, float gain) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_layers.push_back(Layer{ std::move(source), gain, gain, 0 });
+	return _layers.size() - 1;
+}
+
+void AmbientMixer::setGain(size_t layer, float gain, sf::Time fade) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto& l = _layers.at(layer);
+	l.target = gain;
+	float frames = std::max(fade.asSeconds() * _sampleRate, 1.0f);
+	l.step = (l.target - l.gain) / frames;
+}
+
+bool AmbientMixer::isAudible() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const auto& layer : _layers) {
+		if (layer.gain > 0 || layer.target > 0)
+			return true;
+	}
+	return false;
+}
+
+unsigned int AmbientMixer::getMixSampleRate() const {
+	return _sampleRate;
+}
+
+bool AmbientMixer::onGetData(Chunk& data) {
+	std::fill(_mix.begin(), _mix.end(), 0.0f);
+	{
+		// Only held against adding layers and changing gains, which are rare
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto& layer : _layers) {
+			// Silent layers stay paused where they are
+			if (layer.gain <= 0 && layer.target <= 0)
+				continue;
+			layer.source->read(_layerBuffer.data(), MIX_FRAMES);
+
+			// Ramp towards the target, stopping exactly on it part way through the chunk
+			float step = layer.step;
+			size_t rampFrames = MIX_FRAMES;
+			if (step != 0)
+				rampFrames = std::min(MIX_FRAMES, (size_t)std::ceil((layer.target - layer.gain) / step));
+			else
+				rampFrames = 0;
+			AudioKernels::mixStereo(_mix.data(), _layerBuffer.data(), rampFrames, layer.gain, step);
+			if (rampFrames < MIX_FRAMES) {
+				layer.gain = layer.target;
+				layer.step = 0;
+				AudioKernels::mixStereo(_mix.data() + rampFrames * 2, _layerBuffer.data() + rampFrames * 2, MIX_FRAMES - rampFrames, layer.gain, 0);
+			}
+			else {
+				layer.gain += step * MIX_FRAMES;
+			}
+		}
+	}
+	AudioKernels::toInt16(_buffer.data(), _mix.data(), _mix.size());
+	data.samples = _buffer.data();
+	data.sampleCount = _buffer.size();
+	return true;
+}
+
+void AmbientMixer::onSeek(sf::Time) {
+	// Every layer loops forever so there is nothing to seek
+}
@@ -0,0 +1,49 @@
+#include <AmbientSource.h>
+#include <AudioKernels.h>
+#include <SFML/Audio.hpp>
+#include <algorithm>
+
+bool AmbientFileSource::open(const std::string& path, unsigned int sampleRate) {
+	sf::InputSoundFile file;
+	if (!file.openFromFile(path) || file.getSampleCount() == 0)
+		return false;
+	unsigned int channels = file.getChannelCount();
+	std::vector<std::int16_t> decoded(file.getSampleCount());
+	decoded.resize(file.read(decoded.data(), decoded.size()));
+	std::vector<float> samples(decoded.size());
+	AudioKernels::toFloat(samples.data(), decoded.data(), decoded.size());
+
+	// Convert to stereo at the mixer's rate with linear interpolation. Mono is copied to
+	// both channels and anything beyond two channels is dropped
+	size_t frames = samples.size() / channels;
+	double step = (double)file.getSampleRate() / sampleRate;
+	size_t outFrames = (size_t)(frames / step);
+	if (outFrames == 0)
+		return false;
+	_samples.resize(outFrames * 2);
+	for (size_t i = 0; i < outFrames; i++) {
+		double position = i * step;
+		size_t frame = (size_t)position;
+		size_t nextFrame = std::min(frame + 1, frames - 1);
+		float t = (float)(position - frame);
+		for (unsigned int c = 0; c < 2; c++) {
+			unsigned int channel = std::min(c, channels - 1);
+			float a = samples[frame * channels + channel];
+			float b = samples[nextFrame * channels + channel];
+			_samples[i * 2 + c] = a + (b - a) * t;
+		}
+	}
+	_position = 0;
+	return true;
+}
+
+void AmbientFileSource::read(float* out, size_t frames) {
+	size_t samples = frames * 2;
+	while (samples > 0) {
+		size_t count = std::min(samples, _samples.size() - _position);
+		std::copy(_samples.begin() + _position, _samples.begin() + _position + count, out);
+		out += count;
+		samples -= count;
+		_position = (_position + count) % _samples.size();
+	}
+}
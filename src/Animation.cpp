@@ -0,0 +1,112 @@
+#include <Animation.h>
+#include <GraphicsManager.h>
+#include <algorithm>
+#include <cassert>
+
+// Microseconds per step
+static const std::int64_t STEP = 10000;
+
+Animation::Animation(sf::Sprite* sprite, const sf::IntRect& sheet, sf::Vector2i frameSize, const std::vector<sf::Time>& durations, bool looping)
+	: _sprite(sprite), _looping(looping) {
+	assert(sprite && frameSize.x > 0 && frameSize.y > 0 && !durations.empty());
+	int columns = std::max(sheet.size.x / frameSize.x, 1);
+	for (size_t i = 0; i < durations.size(); i++) {
+		sf::Vector2i offset{ (int)(i % columns) * frameSize.x, (int)(i / columns) * frameSize.y };
+		_rects.push_back(sf::IntRect(sheet.position + offset, frameSize));
+		// Every frame shows for at least a step
+		_durations.push_back(std::max(durations[i].asMicroseconds() / STEP, (std::int64_t)1));
+		_length += _durations.back();
+		// Crop the spans of every frame now, rather than the first time each is shown
+		GraphicsManager::getSpans(&sprite->getTexture(), _rects.back());
+	}
+	_sprite->setTextureRect(_rects[0]);
+}
+
+void Animation::play() {
+	_playing = true;
+}
+
+void Animation::stop() {
+	_playing = false;
+	_position = 0;
+	_accumulator = 0;
+	_setFrame(0);
+}
+
+bool Animation::isPlaying() const {
+	return _playing && _rects.size() > 1;
+}
+
+bool Animation::update(sf::Time elapsed) {
+	if (!isPlaying())
+		return false;
+	_accumulator += elapsed.asMicroseconds();
+	std::int64_t steps = _accumulator / STEP;
+	_accumulator %= STEP;
+	// Whole loops end up back on the same frame, so a long sleep only has to get through
+	// whatever is left over
+	if (_looping && steps > _length)
+		steps %= _length;
+
+	size_t frame = _frame;
+	while (steps > 0) {
+		std::int64_t left = _durations[frame] - _position;
+		if (steps < left) {
+			_position += steps;
+			break;
+		}
+		steps -= left;
+		_position = 0;
+		if (frame + 1 < _rects.size()) {
+			frame++;
+		}
+		else if (_looping) {
+			frame = 0;
+		}
+		else {
+			// Stays on the last frame
+			_playing = false;
+			break;
+		}
+	}
+	return _setFrame(frame);
+}
+
+bool Animation::setProgress(float progress) {
+	std::int64_t target = std::clamp((std::int64_t)(progress * _length), (std::int64_t)0, _length - 1);
+	size_t frame = 0;
+	while (target >= _durations[frame]) {
+		target -= _durations[frame];
+		frame++;
+	}
+	_position = target;
+	_accumulator = 0;
+	return _setFrame(frame);
+}
+
+size_t Animation::getFrame() const {
+	return _frame;
+}
+
+size_t Animation::getFrameCount() const {
+	return _rects.size();
+}
+
+sf::Time Animation::getTimeToNextFrame() const {
+	return sf::microseconds((_durations[_frame] - _position) * STEP - _accumulator);
+}
+
+float Animation::getNextFrameProgress() const {
+	std::int64_t end = 0;
+	for (size_t i = 0; i <= _frame; i++)
+		end += _durations[i];
+	return (float)end / _length;
+}
+
+bool Animation::_setFrame(size_t frame) {
+	if (frame == _frame)
+		return false;
+	_frame = frame;
+	_sprite->setTextureRect(_rects[frame]);
+	return true;
+}
@@ -0,0 +1,232 @@
+#include <AudioKernels.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIO_KERNELS_X86
+#include <immintrin.h>
+#ifdef __SSE2__
+#define AUDIO_KERNELS_SSE2
+#endif
+#endif
+
+static void mixStereoScalar(float* out, const float* in, size_t frames, float gain, float gainStep) {
+	for (size_t i = 0; i < frames; i++) {
+		out[i * 2] += in[i * 2] * gain;
+		out[i * 2 + 1] += in[i * 2 + 1] * gain;
+		gain += gainStep;
+	}
+}
+
+static void toInt16Scalar(std::int16_t* out, const float* in, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		out[i] = (std::int16_t)std::clamp(in[i] * 32767.0f, -32768.0f, 32767.0f);
+}
+
+static void toFloatScalar(float* out, const std::int16_t* in, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+static void scaleInt16Scalar(std::int16_t* samples, size_t count, float gain) {
+	for (size_t i = 0; i < count; i++)
+		samples[i] = (std::int16_t)std::clamp(std::nearbyint(samples[i] * gain), -32768.0f, 32767.0f);
+}
+
+static void multiplyAddScalar(float* out, const float* in, size_t count, float gain) {
+	for (size_t i = 0; i < count; i++)
+		out[i] += in[i] * gain;
+}
+
+static float sumSquaresScalar(const float* in, size_t count) {
+	float sum = 0;
+	for (size_t i = 0; i < count; i++)
+		sum += in[i] * in[i];
+	return sum;
+}
+
+static float maxAbsScalar(const float* in, size_t count) {
+	float peak = 0;
+	for (size_t i = 0; i < count; i++)
+		peak = std::max(peak, std::fabs(in[i]));
+	return peak;
+}
+
+#ifdef AUDIO_KERNELS_SSE2
+// Two stereo frames per register, both channels of a frame sharing a gain
+static void mixStereoSSE2(float* out, const float* in, size_t frames, float gain, float gainStep) {
+	__m128 gains = _mm_setr_ps(gain, gain, gain + gainStep, gain + gainStep);
+	const __m128 step = _mm_set1_ps(gainStep * 2);
+	size_t i = 0;
+	for (; i + 2 <= frames; i += 2) {
+		__m128 mixed = _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(_mm_loadu_ps(in + i * 2), gains));
+		_mm_storeu_ps(out + i * 2, mixed);
+		gains = _mm_add_ps(gains, step);
+	}
+	mixStereoScalar(out + i * 2, in + i * 2, frames - i, gain + gainStep * i, gainStep);
+}
+
+// Clamped before converting since out of range conversions come back as INT_MIN
+static void toInt16SSE2(std::int16_t* out, const float* in, size_t count) {
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 minimum = _mm_set1_ps(-1.0f);
+	const __m128 maximum = _mm_set1_ps(1.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128 lowIn = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), minimum), maximum);
+		__m128 highIn = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), minimum), maximum);
+		__m128i low = _mm_cvtps_epi32(_mm_mul_ps(lowIn, scale));
+		__m128i high = _mm_cvtps_epi32(_mm_mul_ps(highIn, scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+	}
+	toInt16Scalar(out + i, in + i, count - i);
+}
+
+// Sign extends by unpacking into the high half of each 32 bit lane and shifting back down
+static void toFloatSSE2(float* out, const std::int16_t* in, size_t count) {
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+	toFloatScalar(out + i, in + i, count - i);
+}
+
+// The gain is kept small enough by the callers that the products fit in 32 bits, and the
+// pack saturates them back down to 16
+static void scaleInt16SSE2(std::int16_t* samples, size_t count, float gain) {
+	const __m128 gains = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+		__m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+		__m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+		__m128i lowOut = _mm_cvtps_epi32(_mm_mul_ps(low, gains));
+		__m128i highOut = _mm_cvtps_epi32(_mm_mul_ps(high, gains));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(lowOut, highOut));
+	}
+	scaleInt16Scalar(samples + i, count - i, gain);
+}
+
+static void multiplyAddSSE2(float* out, const float* in, size_t count, float gain) {
+	const __m128 gains = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), gains)));
+	multiplyAddScalar(out + i, in + i, count - i, gain);
+}
+
+static float sumSquaresSSE2(const float* in, size_t count) {
+	__m128 sums = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 samples = _mm_loadu_ps(in + i);
+		sums = _mm_add_ps(sums, _mm_mul_ps(samples, samples));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, sums);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumSquaresScalar(in + i, count - i);
+}
+
+// Absolute value by clearing the sign bit
+static float maxAbsSSE2(const float* in, size_t count) {
+	const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 peaks = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		peaks = _mm_max_ps(peaks, _mm_and_ps(_mm_loadu_ps(in + i), mask));
+	float lanes[4];
+	_mm_storeu_ps(lanes, peaks);
+	return std::max({ lanes[0], lanes[1], lanes[2], lanes[3], maxAbsScalar(in + i, count - i) });
+}
+#endif
+
+#ifdef AUDIO_KERNELS_X86
+// Four stereo frames per register
+__attribute__((target("avx")))
+static void mixStereoAVX(float* out, const float* in, size_t frames, float gain, float gainStep) {
+	__m256 gains = _mm256_setr_ps(gain, gain, gain + gainStep, gain + gainStep,
+		gain + gainStep * 2, gain + gainStep * 2, gain + gainStep * 3, gain + gainStep * 3);
+	const __m256 step = _mm256_set1_ps(gainStep * 4);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		__m256 mixed = _mm256_add_ps(_mm256_loadu_ps(out + i * 2), _mm256_mul_ps(_mm256_loadu_ps(in + i * 2), gains));
+		_mm256_storeu_ps(out + i * 2, mixed);
+		gains = _mm256_add_ps(gains, step);
+	}
+	mixStereoScalar(out + i * 2, in + i * 2, frames - i, gain + gainStep * i, gainStep);
+}
+#endif
+
+typedef void (*MixStereo)(float* out, const float* in, size_t frames, float gain, float gainStep);
+typedef void (*ToInt16)(std::int16_t* out, const float* in, size_t count);
+typedef void (*ToFloat)(float* out, const std::int16_t* in, size_t count);
+
+static MixStereo selectMixStereo() {
+#ifdef AUDIO_KERNELS_X86
+	if (__builtin_cpu_supports("avx"))
+		return mixStereoAVX;
+#endif
+#ifdef AUDIO_KERNELS_SSE2
+	return mixStereoSSE2;
+#else
+	return mixStereoScalar;
+#endif
+}
+
+void AudioKernels::mixStereo(float* out, const float* in, size_t frames, float gain, float gainStep) {
+	static const MixStereo mix = selectMixStereo();
+	mix(out, in, frames, gain, gainStep);
+}
+
+void AudioKernels::toInt16(std::int16_t* out, const float* in, size_t count) {
+#ifdef AUDIO_KERNELS_SSE2
+	toInt16SSE2(out, in, count);
+#else
+	toInt16Scalar(out, in, count);
+#endif
+}
+
+void AudioKernels::toFloat(float* out, const std::int16_t* in, size_t count) {
+#ifdef AUDIO_KERNELS_SSE2
+	toFloatSSE2(out, in, count);
+#else
+	toFloatScalar(out, in, count);
+#endif
+}
+
+void AudioKernels::scaleInt16(std::int16_t* samples, size_t count, float gain) {
+#ifdef AUDIO_KERNELS_SSE2
+	scaleInt16SSE2(samples, count, gain);
+#else
+	scaleInt16Scalar(samples, count, gain);
+#endif
+}
+
+void AudioKernels::multiplyAdd(float* out, const float* in, size_t count, float gain) {
+#ifdef AUDIO_KERNELS_SSE2
+	multiplyAddSSE2(out, in, count, gain);
+#else
+	multiplyAddScalar(out, in, count, gain);
+#endif
+}
+
+float AudioKernels::sumSquares(const float* in, size_t count) {
+#ifdef AUDIO_KERNELS_SSE2
+	return sumSquaresSSE2(in, count);
+#else
+	return sumSquaresScalar(in, count);
+#endif
+}
+
+float AudioKernels::maxAbs(const float* in, size_t count) {
+#ifdef AUDIO_KERNELS_SSE2
+	return maxAbsSSE2(in, count);
+#else
+	return maxAbsScalar(in, count);
+#endif
+}
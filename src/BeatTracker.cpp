@@ -0,0 +1,155 @@
+#include <BeatTracker.h>
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+static const size_t FRAME_SIZE = 1024;
+static const size_t HOP_SIZE = FRAME_SIZE / 2;
+static const float MIN_TEMPO = 60;
+static const float MAX_TEMPO = 180;
+// Tempos are weighed towards this, an octave either side counting for about half as
+// much, which settles whether a track is at some tempo or double it
+static const float LIKELY_TEMPO = 120;
+// Flux is only an onset where it stands out from the average over this long
+static const float AVERAGE_SECONDS = 0.5f;
+static const float MIN_SECONDS = 8;
+// The period found by autocorrelation is tuned within 1% either side, in steps of 0.05%
+static const int PERIOD_STEPS = 20;
+static const double PERIOD_STEP = 0.0005;
+// Compression of the magnitudes, so quiet onsets still count against loud sustained notes
+static const float COMPRESSION = 100;
+
+BeatTracker::BeatTracker() : _fft(FRAME_SIZE) {
+	_window.resize(FRAME_SIZE);
+	for (size_t i = 0; i < FRAME_SIZE; i++)
+		_window[i] = (float)(0.5 - 0.5 * std::cos(2 * PI * i / FRAME_SIZE));
+	_samples.resize(FRAME_SIZE);
+	_windowed.resize(FRAME_SIZE);
+	_re.resize(FRAME_SIZE / 2 + 1);
+	_im.resize(FRAME_SIZE / 2 + 1);
+	_magnitudes.resize(FRAME_SIZE / 2 + 1);
+	_previous.resize(FRAME_SIZE / 2 + 1);
+}
+
+void BeatTracker::reset(unsigned int sampleRate) {
+	_sampleRate = sampleRate;
+	_filled = 0;
+	std::fill(_previous.begin(), _previous.end(), 0.0f);
+	_flux.clear();
+}
+
+void BeatTracker::process(const float* samples, size_t frames, unsigned int channels) {
+	const float scale = 1.0f / channels;
+	for (size_t i = 0; i < frames; i++) {
+		float sum = 0;
+		for (unsigned int channel = 0; channel < channels; channel++)
+			sum += samples[i * channels + channel];
+		_samples[_filled++] = sum * scale;
+		if (_filled == FRAME_SIZE) {
+			_frame();
+			// Frames overlap by half
+			std::copy(_samples.begin() + HOP_SIZE, _samples.end(), _samples.begin());
+			_filled = FRAME_SIZE - HOP_SIZE;
+		}
+	}
+}
+
+bool BeatTracker::finish(float& tempo, float& offset) {
+	float rate = (float)_sampleRate / HOP_SIZE;
+	size_t count = _flux.size();
+	if (_sampleRate == 0 || count < rate * MIN_SECONDS)
+		return false;
+
+	// Onset strength is however much the flux rises above its local average
+	size_t radius = std::max((size_t)(rate * AVERAGE_SECONDS / 2), (size_t)1);
+	std::vector<float> onsets(count);
+	double sum = 0;
+	size_t start = 0, end = 0;
+	for (size_t i = 0; i < count; i++) {
+		while (end < std::min(i + radius + 1, count))
+			sum += _flux[end++];
+		while (start + radius < i)
+			sum -= _flux[start++];
+		onsets[i] = std::max(_flux[i] - (float)(sum / (end - start)), 0.0f);
+	}
+
+	// Autocorrelation over the lags of the tempo range, each normalised by how many pairs
+	// went into it
+	size_t minLag = (size_t)std::floor(rate * 60 / MAX_TEMPO);
+	size_t maxLag = (size_t)std::ceil(rate * 60 / MIN_TEMPO);
+	if (minLag < 2 || maxLag + 1 >= count)
+		return false;
+	std::vector<double> correlation(maxLag + 2);
+	for (size_t lag = minLag - 1; lag <= maxLag + 1; lag++) {
+		double total = 0;
+		for (size_t i = 0; i + lag < count; i++)
+			total += onsets[i] * onsets[i + lag];
+		correlation[lag] = total / (count - lag);
+	}
+	size_t best = 0;
+	double bestScore = 0;
+	for (size_t lag = minLag; lag <= maxLag; lag++) {
+		double octaves = std::log2(rate * 60 / lag / LIKELY_TEMPO);
+		double score = correlation[lag] * std::exp(-0.5 * octaves * octaves);
+		if (score > bestScore) {
+			bestScore = score;
+			best = lag;
+		}
+	}
+	if (best == 0)
+		return false;
+
+	// The true period is somewhere between lags, found by fitting a parabola to the peak
+	double before = correlation[best - 1], peak = correlation[best], after = correlation[best + 1];
+	double curve = before - 2 * peak + after;
+	double period = best + (curve < 0 ? 0.5 * (before - after) / curve : 0.0);
+
+	// Even a small error in the period drifts the beats a long way by the end of a track,
+	// so the period is fine tuned along with the phase: the pair that lines the most onset
+	// strength up under the beats wins
+	size_t bestPhase = 0;
+	double bestPeriod = period;
+	double bestPhaseScore = -1;
+	for (int step = -PERIOD_STEPS; step <= PERIOD_STEPS; step++) {
+		double candidate = period * (1 + step * PERIOD_STEP);
+		for (size_t phase = 0; phase < best; phase++) {
+			double total = 0;
+			for (size_t beat = 0;; beat++) {
+				size_t position = phase + (size_t)std::lround(beat * candidate);
+				if (position >= count)
+					break;
+				total += onsets[position];
+			}
+			if (total > bestPhaseScore) {
+				bestPhaseScore = total;
+				bestPhase = phase;
+				bestPeriod = candidate;
+			}
+		}
+	}
+
+	// Each flux value is for the frame centred half a frame after its hop
+	float seconds = (float)(bestPeriod / rate);
+	tempo = 60 / seconds;
+	offset = std::fmod((bestPhase * HOP_SIZE + FRAME_SIZE / 2) / (float)_sampleRate, seconds);
+	return true;
+}
+
+float BeatTracker::getPhase(float tempo, float offset, float seconds) {
+	float beats = (seconds - offset) * tempo / 60;
+	return beats - std::floor(beats);
+}
+
+void BeatTracker::_frame() {
+	for (size_t i = 0; i < FRAME_SIZE; i++)
+		_windowed[i] = _samples[i] * _window[i];
+	_fft.forward(_windowed.data(), _re.data(), _im.data());
+	float flux = 0;
+	for (size_t bin = 0; bin < _magnitudes.size(); bin++) {
+		_magnitudes[bin] = std::log1p(COMPRESSION * std::sqrt(_re[bin] * _re[bin] + _im[bin] * _im[bin]));
+		flux += std::max(_magnitudes[bin] - _previous[bin], 0.0f);
+	}
+	// The first frame is measured against silence, so it would always look like an onset
+	_flux.push_back(_flux.empty() ? 0 : flux);
+	std::swap(_magnitudes, _previous);
+}
@@ -7,6 +7,11 @@ Button::Button(std::string path, float x, float y, int width, int height) {
 	_y = y;
 }
 
+Button::~Button() {
+	GraphicsManager::destroySprite(_sprite);
+	delete _text;
+}
+
 bool Button::pressed(const sf::Event::MouseButtonPressed* mouseButtonPressed, sf::Window* window) {
 	// Only dealing with left clicks here
 	if (mouseButtonPressed->button != sf::Mouse::Button::Left)
@@ -40,3 +45,10 @@ void Button::setTextOffset(int x, int y) {
 	_text->setPosition(sf::Vector2f{ _x + x, _y + y });
 }
 
+sf::Sprite* Button::getSprite() {
+	return _sprite;
+}
+
+sf::Text* Button::getText() {
+	return _text;
+}
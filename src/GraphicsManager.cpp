@@ -1,23 +1,131 @@
 #include <GraphicsManager.h>
 #include <OSInterface.h>
 #include <stdio.h>
+#include <algorithm>
+
+std::map<std::string, GraphicsManager::TextureEntry> GraphicsManager::_textureCache;
+TextureAtlas GraphicsManager::_atlas;
+std::map<const sf::Texture*, AlphaSpans> GraphicsManager::_spanCache;
+std::map<std::tuple<const sf::Texture*, int, int, int, int>, AlphaSpans> GraphicsManager::_rectSpanCache;
+
+bool GraphicsManager::loadAtlas(const std::vector<std::string>& names) {
+	if (!_atlas.load(names))
+		return false;
+	// The cache keeps its own reference so the atlas stays loaded between sprites
+	_insert(_atlas.getPath(), _atlas.getImage());
+	return true;
+}
 
 sf::Texture* GraphicsManager::getTexture(std::string path) {
-	static std::map<std::string, sf::Texture*> textureCache;
 	path = OSInterface::asset(path);
-	auto texture = textureCache[path];
-	if (!texture)
-		texture = new sf::Texture();
-	assert(texture->loadFromFile(path));
-	return texture;
+	auto texture = _acquire(path);
+	if (texture)
+		return texture;
+	sf::Image image;
+	bool loaded = image.loadFromFile(path);
+	assert(loaded);
+	return _insert(path, image);
+}
+
+sf::IntRect GraphicsManager::getRect(std::string path) {
+	if (_atlas.contains(path))
+		return _atlas.getRect(path);
+	auto texture = getTexture(path);
+	sf::IntRect rect(sf::Vector2i{0, 0}, sf::Vector2i(texture->getSize()));
+	releaseTexture(texture);
+	return rect;
+}
+
+void GraphicsManager::releaseTexture(const sf::Texture* texture) {
+	for (auto& cached : _textureCache) {
+		if (cached.second.texture != texture)
+			continue;
+		assert(cached.second.references > 0);
+		cached.second.references--;
+		return;
+	}
+}
+
+unsigned int GraphicsManager::evictUnused() {
+	unsigned int evicted = 0;
+	for (auto cached = _textureCache.begin(); cached != _textureCache.end();) {
+		if (cached->second.references > 0) {
+			cached++;
+			continue;
+		}
+		// Span caches are keyed on the texture address, which can be reused after this
+		auto texture = cached->second.texture;
+		_spanCache.erase(texture);
+		for (auto spans = _rectSpanCache.begin(); spans != _rectSpanCache.end();) {
+			if (std::get<0>(spans->first) == texture)
+				spans = _rectSpanCache.erase(spans);
+			else
+				spans++;
+		}
+		delete texture;
+		cached = _textureCache.erase(cached);
+		evicted++;
+	}
+	return evicted;
 }
 
 sf::Sprite* GraphicsManager::createSprite(std::string path, float x, float y, int width, int height) {
-	sf::Sprite* sprite = new sf::Sprite(*getTexture(path));
-	if (sprite == NULL)
-		return NULL;
+	sf::Sprite* sprite = NULL;
+	if (_atlas.contains(path)) {
+		// Crop within the image's own area of the atlas
+		auto rect = _atlas.getRect(path);
+		if (width > 0 && height > 0)
+			rect.size = sf::Vector2i{std::min(width, rect.size.x), std::min(height, rect.size.y)};
+		sprite = new sf::Sprite(*_acquire(_atlas.getPath()), rect);
+	}
+	else {
+		sprite = new sf::Sprite(*getTexture(path));
+		if (width > 0 && height > 0)
+			sprite->setTextureRect(sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{width, height}));
+	}
 	sprite->setPosition(sf::Vector2f{x, y});
-	if (width > 0 && height > 0)
-		sprite->setTextureRect(sf::IntRect(sf::Vector2i{0, 0}, sf::Vector2i{width, height}));
 	return sprite;
 }
+
+void GraphicsManager::destroySprite(sf::Sprite* sprite) {
+	if (!sprite)
+		return;
+	releaseTexture(&sprite->getTexture());
+	delete sprite;
+}
+
+const AlphaSpans& GraphicsManager::getSpans(const sf::Texture* texture) {
+	auto spans = _spanCache.find(texture);
+	if (spans != _spanCache.end())
+		return spans->second;
+	// Textures that did not come from here have to be read back once
+	return _spanCache[texture] = AlphaSpans::fromImage(texture->copyToImage());
+}
+
+const AlphaSpans& GraphicsManager::getSpans(const sf::Texture* texture, const sf::IntRect& rect) {
+	auto key = std::make_tuple(texture, rect.position.x, rect.position.y, rect.size.x, rect.size.y);
+	auto spans = _rectSpanCache.find(key);
+	if (spans != _rectSpanCache.end())
+		return spans->second;
+	return _rectSpanCache[key] = getSpans(texture).crop(rect);
+}
+
+sf::Texture* GraphicsManager::_acquire(const std::string& key) {
+	auto cached = _textureCache.find(key);
+	if (cached == _textureCache.end())
+		return NULL;
+	cached->second.references++;
+	return cached->second.texture;
+}
+
+sf::Texture* GraphicsManager::_insert(const std::string& key, const sf::Image& image) {
+	assert(!_textureCache.count(key));
+	auto texture = new sf::Texture();
+	bool loaded = texture->loadFromImage(image);
+	assert(loaded);
+	// Keep the alpha spans of the image while it is still on the CPU so window shapes
+	// can be built without reading the texture back
+	_spanCache[texture] = AlphaSpans::fromImage(image);
+	_textureCache[key] = TextureEntry{ texture, 1 };
+	return texture;
+}
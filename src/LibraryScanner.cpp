@@ -0,0 +1,205 @@
+#include <LibraryScanner.h>
+#include <ThreadPool.h>
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+std::vector<TrackInfo> LibraryScanner::scan(const std::string& directory, MetadataCache& cache) {
+	std::vector<TrackInfo> tracks;
+	std::mutex mutex;
+	{
+		ThreadPool pool;
+		pool.submit([&, directory] { _walk(directory, pool, cache, tracks, mutex); });
+		pool.wait();
+	}
+	cache.flush();
+	std::sort(tracks.begin(), tracks.end(), [](const TrackInfo& a, const TrackInfo& b) { return a.path < b.path; });
+	return tracks;
+}
+
+void LibraryScanner::_walk(const std::string& directory, ThreadPool& pool, MetadataCache& cache, std::vector<TrackInfo>& tracks, std::mutex& mutex) {
+	std::error_code error;
+	auto options = std::filesystem::directory_options::skip_permission_denied;
+	for (std::filesystem::directory_iterator it(directory, options, error), end; !error && it != end; it.increment(error)) {
+		auto& entry = *it;
+		std::error_code entryError;
+		// Symlinked folders are not followed so a link back up the tree cannot loop forever
+		if (entry.is_directory(entryError) && !entry.is_symlink(entryError)) {
+			auto subdirectory = entry.path().string();
+			pool.submit([&, subdirectory] { _walk(subdirectory, pool, cache, tracks, mutex); });
+			continue;
+		}
+		auto path = entry.path().string();
+		if (!entry.is_regular_file(entryError) || !isAudioFile(path))
+			continue;
+		TrackInfo info;
+		std::uint64_t modified = entry.last_write_time(entryError).time_since_epoch().count();
+		std::uint64_t size = entry.file_size(entryError);
+		if (entryError)
+			continue;
+		if (cache.find(path, modified, size, info)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			tracks.push_back(std::move(info));
+			continue;
+		}
+		// Opening the file is the slow part, especially over the network, so each one is a job
+		pool.submit([&, path, modified, size] {
+			TrackInfo info;
+			if (!probe(path, info))
+				return;
+			info.modified = modified;
+			info.size = size;
+			cache.put(info);
+			std::lock_guard<std::mutex> lock(mutex);
+			tracks.push_back(std::move(info));
+		});
+	}
+}
+
+bool LibraryScanner::isAudioFile(const std::string& path) {
+	auto extension = std::filesystem::path(path).extension().string();
+	for (auto& c : extension)
+		c = tolower((unsigned char)c);
+	return extension == ".mp3" || extension == ".ogg" || extension == ".flac" || extension == ".wav";
+}
+
+// Fills in everything but the modification time and size
+bool LibraryScanner::probe(const std::string& path, TrackInfo& info) {
+	sf::InputSoundFile file;
+	if (!file.openFromFile(path))
+		return false;
+	info.path = path;
+	info.duration = file.getDuration().asSeconds();
+	info.sampleRate = file.getSampleRate();
+	info.channels = file.getChannelCount();
+	_readId3(path, info);
+	if (info.title.empty())
+		info.title = std::filesystem::path(path).stem().string();
+	return true;
+}
+
+// ID3v2 text is Latin-1, UTF-16 with a byte order mark, UTF-16BE or UTF-8
+static std::string decodeText(const unsigned char* data, size_t size) {
+	if (size == 0)
+		return "";
+	unsigned char encoding = data[0];
+	data++;
+	size--;
+	std::string text;
+	if (encoding == 3) {
+		text.assign((const char*)data, size);
+	}
+	else if (encoding == 0) {
+		for (size_t i = 0; i < size; i++) {
+			if (data[i] < 0x80) {
+				text += (char)data[i];
+			}
+			else {
+				text += (char)(0xC0 | (data[i] >> 6));
+				text += (char)(0x80 | (data[i] & 0x3F));
+			}
+		}
+	}
+	else {
+		bool bigEndian = true;
+		if (encoding == 1 && size >= 2) {
+			bigEndian = !(data[0] == 0xFF && data[1] == 0xFE);
+			data += 2;
+			size -= 2;
+		}
+		for (size_t i = 0; i + 1 < size; i += 2) {
+			std::uint32_t c = bigEndian ? (data[i] << 8 | data[i + 1]) : (data[i + 1] << 8 | data[i]);
+			// Surrogate pair
+			if (c >= 0xD800 && c < 0xDC00 && i + 3 < size) {
+				std::uint32_t low = bigEndian ? (data[i + 2] << 8 | data[i + 3]) : (data[i + 3] << 8 | data[i + 2]);
+				c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+				i += 2;
+			}
+			if (c < 0x80) {
+				text += (char)c;
+			}
+			else if (c < 0x800) {
+				text += (char)(0xC0 | (c >> 6));
+				text += (char)(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000) {
+				text += (char)(0xE0 | (c >> 12));
+				text += (char)(0x80 | ((c >> 6) & 0x3F));
+				text += (char)(0x80 | (c & 0x3F));
+			}
+			else {
+				text += (char)(0xF0 | (c >> 18));
+				text += (char)(0x80 | ((c >> 12) & 0x3F));
+				text += (char)(0x80 | ((c >> 6) & 0x3F));
+				text += (char)(0x80 | (c & 0x3F));
+			}
+		}
+	}
+	// Frames may be null terminated, or hold several null separated values
+	auto terminator = text.find('\0');
+	if (terminator != std::string::npos)
+		text.resize(terminator);
+	return text;
+}
+
+static std::uint32_t syncsafe(const unsigned char* bytes) {
+	return (bytes[0] & 0x7F) << 21 | (bytes[1] & 0x7F) << 14 | (bytes[2] & 0x7F) << 7 | (bytes[3] & 0x7F);
+}
+
+// Reads title, artist and album from an ID3v2 tag at the start of the file. Only the
+// frames wanted are read and everything else, like cover art, is skipped over. Tags using
+// unsynchronisation are rare enough to ignore
+void LibraryScanner::_readId3(const std::string& path, TrackInfo& info) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return;
+	unsigned char header[10];
+	if (fread(header, 1, 10, file) != 10 || memcmp(header, "ID3", 3) != 0 || header[3] < 2 || header[3] > 4) {
+		fclose(file);
+		return;
+	}
+	unsigned int version = header[3];
+	long end = 10 + syncsafe(header + 6);
+	// Skip the extended header
+	if (version >= 3 && (header[5] & 0x40)) {
+		unsigned char extended[4];
+		if (fread(extended, 1, 4, file) == 4)
+			fseek(file, version == 4 ? syncsafe(extended) - 4 : (extended[0] << 24 | extended[1] << 16 | extended[2] << 8 | extended[3]), SEEK_CUR);
+	}
+	size_t idLength = version == 2 ? 3 : 4;
+	size_t headerLength = version == 2 ? 6 : 10;
+	std::vector<unsigned char> frame;
+	while (ftell(file) + (long)headerLength <= end) {
+		unsigned char frameHeader[10];
+		if (fread(frameHeader, 1, headerLength, file) != headerLength || frameHeader[0] == 0)
+			break;
+		std::uint32_t size;
+		if (version == 2)
+			size = frameHeader[3] << 16 | frameHeader[4] << 8 | frameHeader[5];
+		else if (version == 4)
+			size = syncsafe(frameHeader + 4);
+		else
+			size = frameHeader[4] << 24 | frameHeader[5] << 16 | frameHeader[6] << 8 | frameHeader[7];
+		if (ftell(file) + (long)size > end)
+			break;
+		std::string* field = NULL;
+		std::string id((const char*)frameHeader, idLength);
+		if (id == "TIT2" || id == "TT2")
+			field = &info.title;
+		else if (id == "TPE1" || id == "TP1")
+			field = &info.artist;
+		else if (id == "TALB" || id == "TAL")
+			field = &info.album;
+		if (!field) {
+			fseek(file, size, SEEK_CUR);
+			continue;
+		}
+		frame.resize(size);
+		if (fread(frame.data(), 1, size, file) != size)
+			break;
+		*field = decodeText(frame.data(), size);
+	}
+	fclose(file);
+}
@@ -0,0 +1,220 @@
+#include <LoudnessAnalyzer.h>
+#include <AudioKernels.h>
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define LOUDNESS_ANALYZER_SSE2
+#include <immintrin.h>
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const size_t READ_FRAMES = 4096;
+// Taps per phase of the oversampling filter
+static const size_t PHASE_TAPS = 12;
+static const unsigned int OVERSAMPLE = 4;
+// Very quiet tracks are only brought up by 12dB, rather than boosting what is mostly noise
+static const float MAX_GAIN = 4.0f;
+
+// Direct form II transposed
+struct Biquad {
+	double b0, b1, b2, a1, a2;
+	double z1 = 0, z2 = 0;
+	void process(float* samples, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			double x = samples[i];
+			double y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			samples[i] = (float)y;
+		}
+	}
+};
+
+#ifdef LOUDNESS_ANALYZER_SSE2
+// Each sample depends on the one before, so the filter can only go wide across channels.
+// Both channels of a pair share the coefficients and run through in one register
+static void processPair(Biquad& left, Biquad& right, float* a, float* b, size_t count) {
+	__m128d b0 = _mm_set1_pd(left.b0), b1 = _mm_set1_pd(left.b1), b2 = _mm_set1_pd(left.b2);
+	__m128d a1 = _mm_set1_pd(left.a1), a2 = _mm_set1_pd(left.a2);
+	__m128d z1 = _mm_setr_pd(left.z1, right.z1);
+	__m128d z2 = _mm_setr_pd(left.z2, right.z2);
+	for (size_t i = 0; i < count; i++) {
+		__m128d x = _mm_setr_pd(a[i], b[i]);
+		__m128d y = _mm_add_pd(_mm_mul_pd(b0, x), z1);
+		z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), z2);
+		z2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+		a[i] = (float)_mm_cvtsd_f64(y);
+		b[i] = (float)_mm_cvtsd_f64(_mm_unpackhi_pd(y, y));
+	}
+	_mm_storel_pd(&left.z1, z1);
+	_mm_storeh_pd(&right.z1, z1);
+	_mm_storel_pd(&left.z2, z2);
+	_mm_storeh_pd(&right.z2, z2);
+}
+#endif
+
+// The two stages of the BS.1770 K-weighting filter, a high shelf then a high pass, worked
+// out for any sample rate from their analogue prototypes
+static void kWeighting(unsigned int sampleRate, Biquad& shelf, Biquad& highPass) {
+	double f0 = 1681.974450955533;
+	double gain = 3.999843853973347;
+	double q = 0.7071752369554196;
+	double k = std::tan(PI * f0 / sampleRate);
+	double vh = std::pow(10.0, gain / 20.0);
+	double vb = std::pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	shelf.b0 = (vh + vb * k / q + k * k) / a0;
+	shelf.b1 = 2.0 * (k * k - vh) / a0;
+	shelf.b2 = (vh - vb * k / q + k * k) / a0;
+	shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = std::tan(PI * f0 / sampleRate);
+	a0 = 1.0 + k / q + k * k;
+	highPass.b0 = 1.0;
+	highPass.b1 = -2.0;
+	highPass.b2 = 1.0;
+	highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+	highPass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+// Windowed sinc low pass at the original Nyquist frequency, split into one filter per
+// phase of the oversampled output
+static std::vector<std::vector<float>> oversamplingFilter() {
+	size_t taps = PHASE_TAPS * OVERSAMPLE;
+	std::vector<std::vector<float>> phases(OVERSAMPLE, std::vector<float>(PHASE_TAPS));
+	for (size_t i = 0; i < taps; i++) {
+		double t = ((double)i - (taps - 1) / 2.0) / OVERSAMPLE;
+		double sinc = t == 0 ? 1.0 : std::sin(PI * t) / (PI * t);
+		double window = 0.5 - 0.5 * std::cos(2.0 * PI * (i + 0.5) / taps);
+		phases[i % OVERSAMPLE][i / OVERSAMPLE] = (float)(sinc * window);
+	}
+	return phases;
+}
+
+bool LoudnessAnalyzer::analyze(const std::string& path, float& loudness, float& peak, const std::atomic<bool>* cancel, BeatTracker* beats) {
+	sf::InputSoundFile file;
+	if (!file.openFromFile(path))
+		return false;
+	unsigned int channels = file.getChannelCount();
+	unsigned int sampleRate = file.getSampleRate();
+	if (channels == 0 || sampleRate < 10)
+		return false;
+	static const auto phases = oversamplingFilter();
+	if (beats)
+		beats->reset(sampleRate);
+
+	std::vector<Biquad> shelves(channels), highPasses(channels);
+	for (unsigned int c = 0; c < channels; c++)
+		kWeighting(sampleRate, shelves[c], highPasses[c]);
+
+	// Energy of each 100ms step, summed over the channels. Blocks are four steps long and
+	// start every step, so they overlap by 75%
+	size_t stepFrames = sampleRate / 10;
+	std::vector<double> steps;
+	double stepEnergy = 0;
+	size_t stepPosition = 0;
+
+	std::vector<std::int16_t> interleaved(READ_FRAMES * channels);
+	std::vector<float> samples(READ_FRAMES * channels);
+	// Each channel on its own, after the last PHASE_TAPS - 1 samples of the previous read
+	std::vector<std::vector<float>> input(channels, std::vector<float>(PHASE_TAPS - 1 + READ_FRAMES));
+	std::vector<std::vector<float>> weighted(channels, std::vector<float>(READ_FRAMES));
+	std::vector<float> oversampled(READ_FRAMES);
+	float maxPeak = 0;
+
+	while (true) {
+		if (cancel && *cancel)
+			return false;
+		size_t frames = file.read(interleaved.data(), interleaved.size()) / channels;
+		if (frames == 0)
+			break;
+		AudioKernels::toFloat(samples.data(), interleaved.data(), frames * channels);
+		if (beats)
+			beats->process(samples.data(), frames, channels);
+
+		for (unsigned int c = 0; c < channels; c++) {
+			float* current = input[c].data() + PHASE_TAPS - 1;
+			for (size_t i = 0; i < frames; i++)
+				current[i] = samples[i * channels + c];
+
+			// True peak: each phase of the oversampled signal is its own FIR over the input
+			for (unsigned int p = 0; p < OVERSAMPLE; p++) {
+				std::fill(oversampled.begin(), oversampled.begin() + frames, 0.0f);
+				for (size_t k = 0; k < PHASE_TAPS; k++)
+					AudioKernels::multiplyAdd(oversampled.data(), current - k, frames, phases[p][k]);
+				maxPeak = std::max(maxPeak, AudioKernels::maxAbs(oversampled.data(), frames));
+			}
+
+			std::copy(current, current + frames, weighted[c].begin());
+			// Keep the end of this read for the start of the next
+			std::copy(current + frames - (PHASE_TAPS - 1), current + frames, input[c].begin());
+		}
+
+		unsigned int c = 0;
+#ifdef LOUDNESS_ANALYZER_SSE2
+		for (; c + 1 < channels; c += 2) {
+			processPair(shelves[c], shelves[c + 1], weighted[c].data(), weighted[c + 1].data(), frames);
+			processPair(highPasses[c], highPasses[c + 1], weighted[c].data(), weighted[c + 1].data(), frames);
+		}
+#endif
+		for (; c < channels; c++) {
+			shelves[c].process(weighted[c].data(), frames);
+			highPasses[c].process(weighted[c].data(), frames);
+		}
+
+		for (size_t done = 0; done < frames;) {
+			size_t count = std::min(frames - done, stepFrames - stepPosition);
+			for (unsigned int c = 0; c < channels; c++)
+				stepEnergy += AudioKernels::sumSquares(weighted[c].data() + done, count);
+			done += count;
+			stepPosition += count;
+			if (stepPosition == stepFrames) {
+				steps.push_back(stepEnergy);
+				stepEnergy = 0;
+				stepPosition = 0;
+			}
+		}
+	}
+	if (steps.size() < 4)
+		return false;
+
+	// Mean square of each block, then the two gates: an absolute one at -70 LUFS and a
+	// relative one 10 LU under the loudness of the blocks that passed the first
+	std::vector<double> blocks;
+	for (size_t i = 3; i < steps.size(); i++)
+		blocks.push_back((steps[i - 3] + steps[i - 2] + steps[i - 1] + steps[i]) / (4.0 * stepFrames));
+	auto toLoudness = [](double energy) { return -0.691 + 10.0 * std::log10(energy); };
+	auto gatedMean = [&blocks, &toLoudness](double threshold) {
+		double sum = 0;
+		size_t count = 0;
+		for (auto energy : blocks) {
+			if (energy > 0 && toLoudness(energy) > threshold) {
+				sum += energy;
+				count++;
+			}
+		}
+		return count > 0 ? sum / count : 0.0;
+	};
+	double absolute = gatedMean(-70.0);
+	if (absolute <= 0)
+		return false;
+	double relative = gatedMean(toLoudness(absolute) - 10.0);
+	if (relative <= 0)
+		return false;
+	loudness = (float)toLoudness(relative);
+	peak = maxPeak;
+	return true;
+}
+
+float LoudnessAnalyzer::getGain(float loudness, float peak, float target) {
+	float gain = std::pow(10.0f, (target - loudness) / 20.0f);
+	if (peak > 0)
+		gain = std::min(gain, 1.0f / peak);
+	return std::min(gain, MAX_GAIN);
+}
@@ -0,0 +1,111 @@
+#include <LoudnessScanner.h>
+#include <LibraryScanner.h>
+#include <LoudnessAnalyzer.h>
+#include <OSInterface.h>
+#include <algorithm>
+#include <filesystem>
+
+// Results between writes of the cache log to disk
+static const size_t FLUSH_INTERVAL = 32;
+
+static unsigned int defaultThreads(unsigned int threads) {
+	return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency() / 2);
+}
+
+LoudnessScanner::LoudnessScanner(MetadataCache& cache, unsigned int threads)
+	: _cache(cache), _threads(defaultThreads(threads)), _pool(_threads, OSInterface::lowerThreadPriority) {
+}
+
+LoudnessScanner::~LoudnessScanner() {
+	// Tracks part way through are given up on and measured again next time
+	_stop = true;
+	_pool.wait();
+	_cache.flush();
+}
+
+void LoudnessScanner::add(const std::string& path) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_paths.push_back(path);
+	// Workers run until the queue is empty, so only start more if some have finished
+	if (_workers < _threads) {
+		_workers++;
+		_pool.submit([this] { _work(); });
+	}
+}
+
+float LoudnessScanner::getGain(const std::string& path, float target) {
+	TrackInfo info;
+	if (!_cache.find(path, info) || std::isnan(info.loudness))
+		return 1;
+	return LoudnessAnalyzer::getGain(info.loudness, info.peak, target);
+}
+
+bool LoudnessScanner::getBeat(const std::string& path, float& tempo, float& offset) {
+	TrackInfo info;
+	if (!_cache.find(path, info) || !(info.tempo > 0))
+		return false;
+	tempo = info.tempo;
+	offset = info.beatOffset;
+	return true;
+}
+
+bool LoudnessScanner::pollAnalysed() {
+	return _analysed.exchange(false);
+}
+
+void LoudnessScanner::_work() {
+	while (true) {
+		std::string path;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			// Given up under the same lock add takes, so a path added just as the queue runs
+			// out always has a worker for it
+			if (_stop || _paths.empty()) {
+				_workers--;
+				return;
+			}
+			path = std::move(_paths.front());
+			_paths.pop_front();
+		}
+		_analyze(path);
+	}
+}
+
+void LoudnessScanner::_analyze(const std::string& path) {
+	std::error_code error;
+	std::uint64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error)
+		return;
+	std::uint64_t size = std::filesystem::file_size(path, error);
+	if (error)
+		return;
+	TrackInfo info;
+	bool cached = _cache.find(path, modified, size, info);
+	if (cached && !std::isnan(info.loudness) && !std::isnan(info.tempo))
+		return;
+	// Tracks that were never scanned get the rest of their details filled in as well
+	if (!cached) {
+		if (!LibraryScanner::probe(path, info))
+			return;
+		info.modified = modified;
+		info.size = size;
+	}
+	BeatTracker beats;
+	if (!LoudnessAnalyzer::analyze(path, info.loudness, info.peak, &_stop, &beats))
+		return;
+	if (!beats.finish(info.tempo, info.beatOffset)) {
+		info.tempo = 0;
+		info.beatOffset = 0;
+	}
+	_cache.put(info);
+	_analysed = true;
+	bool flush;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		flush = ++_unflushed >= FLUSH_INTERVAL;
+		if (flush)
+			_unflushed = 0;
+	}
+	if (flush)
+		_cache.flush();
+}
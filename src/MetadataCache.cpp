@@ -0,0 +1,392 @@
+#include <MetadataCache.h>
+#include <OSInterface.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+static const char MAGIC[4] = { 'L', 'B', 'M', 'D' };
+static const std::uint32_t VERSION = 3;
+static const char LOG_MAGIC[4] = { 'L', 'B', 'M', 'L' };
+// Log entries beyond this get folded into the database on flush
+static const size_t COMPACT_THRESHOLD = 1024;
+
+// Everything is in host byte order; the files are only read on the machine that wrote
+// them, and a file that fails to validate just means tracks get probed again
+struct MetadataCache::Header {
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t recordCount;
+	// Offset from the start of the file
+	std::uint64_t stringsOffset;
+	std::uint64_t stringsSize;
+};
+
+// Records are sorted by path hash. Strings are offsets and lengths into the string table
+struct MetadataCache::Record {
+	std::uint64_t hash;
+	std::uint64_t modified;
+	std::uint64_t size;
+	float duration;
+	std::uint32_t sampleRate;
+	std::uint32_t channels;
+	std::uint32_t path;
+	std::uint32_t pathLength;
+	std::uint32_t title;
+	std::uint32_t titleLength;
+	std::uint32_t artist;
+	std::uint32_t artistLength;
+	std::uint32_t album;
+	std::uint32_t albumLength;
+	float loudness;
+	float peak;
+	float tempo;
+	float beatOffset;
+	std::uint32_t padding;
+};
+
+// FNV-1a
+static std::uint64_t hashPath(const std::string& path) {
+	std::uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// The log is a sequence of length prefixed entries in this format
+template<typename T>
+static void writeValue(std::vector<char>& out, T value) {
+	const char* bytes = (const char*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void writeString(std::vector<char>& out, const std::string& value) {
+	writeValue<std::uint32_t>(out, value.size());
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+template<typename T>
+static bool readValue(const char*& in, const char* end, T& value) {
+	if ((size_t)(end - in) < sizeof(T))
+		return false;
+	memcpy(&value, in, sizeof(T));
+	in += sizeof(T);
+	return true;
+}
+
+static bool readString(const char*& in, const char* end, std::string& value) {
+	std::uint32_t length;
+	if (!readValue(in, end, length) || (size_t)(end - in) < length)
+		return false;
+	value.assign(in, length);
+	in += length;
+	return true;
+}
+
+static void writeEntry(std::vector<char>& out, const TrackInfo& info) {
+	writeString(out, info.path);
+	writeValue(out, info.modified);
+	writeValue(out, info.size);
+	writeValue(out, info.duration);
+	writeValue(out, info.sampleRate);
+	writeValue(out, info.channels);
+	writeString(out, info.title);
+	writeString(out, info.artist);
+	writeString(out, info.album);
+	writeValue(out, info.loudness);
+	writeValue(out, info.peak);
+	writeValue(out, info.tempo);
+	writeValue(out, info.beatOffset);
+}
+
+static bool readEntry(const char*& in, const char* end, TrackInfo& info) {
+	return readString(in, end, info.path)
+		&& readValue(in, end, info.modified)
+		&& readValue(in, end, info.size)
+		&& readValue(in, end, info.duration)
+		&& readValue(in, end, info.sampleRate)
+		&& readValue(in, end, info.channels)
+		&& readString(in, end, info.title)
+		&& readString(in, end, info.artist)
+		&& readString(in, end, info.album)
+		&& readValue(in, end, info.loudness)
+		&& readValue(in, end, info.peak)
+		&& readValue(in, end, info.tempo)
+		&& readValue(in, end, info.beatOffset);
+}
+
+MetadataCache::~MetadataCache() {
+	if (_logFile)
+		fclose(_logFile);
+	_unmap();
+}
+
+std::string MetadataCache::getPath() {
+	return OSInterface::getConfigPath() + "/library.db";
+}
+
+std::string MetadataCache::getLogPath() {
+	return OSInterface::getConfigPath() + "/library.log";
+}
+
+// Maps the database and checks the layout once, after which lookups trust it
+void MetadataCache::_map() {
+	_data = OSInterface::mapFile(getPath(), _dataSize);
+	if (!_data)
+		return;
+	auto header = (const Header*)_data;
+	bool valid = _dataSize >= sizeof(Header)
+		&& memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header->version == VERSION
+		&& header->recordCount <= (_dataSize - sizeof(Header)) / sizeof(Record)
+		&& header->stringsOffset >= sizeof(Header) + header->recordCount * sizeof(Record)
+		&& header->stringsOffset <= _dataSize
+		&& header->stringsSize <= _dataSize - header->stringsOffset;
+	if (!valid) {
+		_unmap();
+		return;
+	}
+	_records = (const Record*)((const char*)_data + sizeof(Header));
+	_recordCount = header->recordCount;
+	_strings = (const char*)_data + header->stringsOffset;
+	_stringsSize = header->stringsSize;
+}
+
+void MetadataCache::_unmap() {
+	OSInterface::unmapFile(_data, _dataSize);
+	_data = NULL;
+	_dataSize = 0;
+	_records = NULL;
+	_recordCount = 0;
+	_strings = NULL;
+	_stringsSize = 0;
+}
+
+bool MetadataCache::load() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_logFile) {
+		fclose(_logFile);
+		_logFile = NULL;
+	}
+	_unmap();
+	_log.clear();
+
+	// The cache written before the database, which nothing reads any more
+	std::error_code error;
+	std::filesystem::remove(OSInterface::getConfigPath() + "/library.cache", error);
+
+	_map();
+
+	// Replay the log. Anything after a torn write at the end is dropped, as are entries
+	// written by older versions, which are too short
+	FILE* file = fopen(getLogPath().c_str(), "rb");
+	if (file) {
+		std::vector<char> data;
+		char buffer[64 * 1024];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + count);
+		fclose(file);
+		const char* in = data.data();
+		const char* end = in + data.size();
+		if (data.size() >= sizeof(LOG_MAGIC) && memcmp(in, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0) {
+			in += sizeof(LOG_MAGIC);
+			std::uint32_t length;
+			while (readValue(in, end, length) && (size_t)(end - in) >= length) {
+				const char* entryEnd = in + length;
+				TrackInfo info;
+				if (readEntry(in, entryEnd, info))
+					_log[info.path] = std::move(info);
+				in = entryEnd;
+			}
+		}
+	}
+	return _data != NULL || !_log.empty();
+}
+
+bool MetadataCache::_findMapped(const std::string& path, TrackInfo& info) {
+	std::uint64_t hash = hashPath(path);
+	auto record = std::lower_bound(_records, _records + _recordCount, hash, [](const Record& record, std::uint64_t hash) { return record.hash < hash; });
+	auto string = [this](std::uint32_t offset, std::uint32_t length) {
+		if ((std::uint64_t)offset + length > _stringsSize)
+			return std::string();
+		return std::string(_strings + offset, length);
+	};
+	// Step over any other paths with the same hash
+	for (; record != _records + _recordCount && record->hash == hash; record++) {
+		if ((std::uint64_t)record->path + record->pathLength > _stringsSize)
+			continue;
+		if (path.size() != record->pathLength || memcmp(path.data(), _strings + record->path, path.size()) != 0)
+			continue;
+		info.path = path;
+		info.modified = record->modified;
+		info.size = record->size;
+		info.duration = record->duration;
+		info.sampleRate = record->sampleRate;
+		info.channels = record->channels;
+		info.title = string(record->title, record->titleLength);
+		info.artist = string(record->artist, record->artistLength);
+		info.album = string(record->album, record->albumLength);
+		info.loudness = record->loudness;
+		info.peak = record->peak;
+		info.tempo = record->tempo;
+		info.beatOffset = record->beatOffset;
+		return true;
+	}
+	return false;
+}
+
+bool MetadataCache::_find(const std::string& path, TrackInfo& info) {
+	auto found = _log.find(path);
+	if (found != _log.end()) {
+		info = found->second;
+		return true;
+	}
+	return _findMapped(path, info);
+}
+
+bool MetadataCache::find(const std::string& path, std::uint64_t modified, std::uint64_t size, TrackInfo& info) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	TrackInfo found;
+	if (!_find(path, found) || found.modified != modified || found.size != size)
+		return false;
+	info = std::move(found);
+	return true;
+}
+
+bool MetadataCache::find(const std::string& path, TrackInfo& info) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _find(path, info);
+}
+
+void MetadataCache::put(const TrackInfo& info) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_log[info.path] = info;
+	if (!_logFile) {
+		bool exists = std::filesystem::exists(getLogPath());
+		_logFile = fopen(getLogPath().c_str(), "ab");
+		if (!_logFile)
+			return;
+		if (!exists)
+			fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), _logFile);
+	}
+	std::vector<char> entry;
+	writeEntry(entry, info);
+	std::uint32_t length = entry.size();
+	fwrite(&length, sizeof(length), 1, _logFile);
+	fwrite(entry.data(), 1, entry.size(), _logFile);
+}
+
+bool MetadataCache::flush() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_log.size() >= COMPACT_THRESHOLD)
+		return _compact();
+	return !_logFile || fflush(_logFile) == 0;
+}
+
+bool MetadataCache::compact() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _compact();
+}
+
+size_t MetadataCache::size() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t count = _recordCount;
+	for (auto& [path, info] : _log) {
+		TrackInfo mapped;
+		if (!_findMapped(path, mapped))
+			count++;
+	}
+	return count;
+}
+
+// Merges the log into a new database, swaps it in and starts an empty log
+bool MetadataCache::_compact() {
+	std::vector<TrackInfo> tracks;
+	tracks.reserve(_recordCount + _log.size());
+	for (std::uint64_t i = 0; i < _recordCount; i++) {
+		auto& record = _records[i];
+		if ((std::uint64_t)record.path + record.pathLength > _stringsSize)
+			continue;
+		std::string path(_strings + record.path, record.pathLength);
+		if (_log.count(path))
+			continue;
+		tracks.emplace_back();
+		_findMapped(path, tracks.back());
+	}
+	for (auto& [path, info] : _log)
+		tracks.push_back(info);
+
+	std::vector<std::pair<std::uint64_t, size_t>> order;
+	order.reserve(tracks.size());
+	for (size_t i = 0; i < tracks.size(); i++)
+		order.emplace_back(hashPath(tracks[i].path), i);
+	std::sort(order.begin(), order.end());
+
+	std::vector<Record> records;
+	records.reserve(tracks.size());
+	std::vector<char> strings;
+	auto addString = [&strings](const std::string& value, std::uint32_t& offset, std::uint32_t& length) {
+		offset = strings.size();
+		length = value.size();
+		strings.insert(strings.end(), value.begin(), value.end());
+	};
+	for (auto& [hash, index] : order) {
+		auto& info = tracks[index];
+		Record record = {};
+		record.hash = hash;
+		record.modified = info.modified;
+		record.size = info.size;
+		record.duration = info.duration;
+		record.sampleRate = info.sampleRate;
+		record.channels = info.channels;
+		addString(info.path, record.path, record.pathLength);
+		addString(info.title, record.title, record.titleLength);
+		addString(info.artist, record.artist, record.artistLength);
+		addString(info.album, record.album, record.albumLength);
+		record.loudness = info.loudness;
+		record.peak = info.peak;
+		record.tempo = info.tempo;
+		record.beatOffset = info.beatOffset;
+		records.push_back(record);
+	}
+	if (strings.size() > UINT32_MAX)
+		return false;
+
+	Header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.recordCount = records.size();
+	header.stringsOffset = sizeof(Header) + records.size() * sizeof(Record);
+	header.stringsSize = strings.size();
+
+	// Write next to the database and swap it in so a crash never leaves half a file
+	auto path = getPath();
+	auto temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+	ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		return false;
+	// Windows will not replace a file that is mapped
+	_unmap();
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (!error) {
+		if (_logFile) {
+			fclose(_logFile);
+			_logFile = NULL;
+		}
+		std::filesystem::remove(getLogPath(), error);
+		_log.clear();
+	}
+	// Map whichever database is now in place
+	_map();
+	return !error;
+}
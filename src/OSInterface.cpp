@@ -1,6 +1,18 @@
 #include <OSInterface.h>
 #include <filesystem>
 #include <cstdlib>
+#include <chrono>
+#include <stdio.h>
+
+static OSInterface::ShapeMode shapeMode = OSInterface::ShapeMode::Delta;
+
+void OSInterface::setShapeMode(ShapeMode mode) {
+	shapeMode = mode;
+}
+
+bool OSInterface::setTransparency(sf::Window* w, const sf::Image& image) {
+	return setTransparency(w, AlphaSpans::fromImage(image));
+}
 
 std::string OSInterface::asset(std::string fileName) {
 	return OSInterface::getExecutableDir() + "/" + fileName;
@@ -42,11 +54,20 @@ std::string OSInterface::getConfigPath() {
 #include <windows.h>
 #include <shlwapi.h>  
 #include <filesystem>
+#include <set>
+#include <vector>
  
 // Link against Shlwapi.lib (Windows only)  
 #pragma comment(lib, "shlwapi.lib")  
 
-void OSInterface::cleanupWindow(sf::Window* window) {}
+// Windows already made topmost. It is a persistent window style on Windows so it only
+// needs setting once per window
+static std::set<HWND> topmost;
+
+void OSInterface::cleanupWindow(sf::Window* window) {
+	// A later window may be given the same handle
+	topmost.erase(window->getNativeHandle());
+}
  
 std::string OSInterface::getExecutableDir() {  
     char buffer[MAX_PATH]; // MAX_PATH is 260 (Windows path limit)  
@@ -62,6 +83,38 @@ std::string OSInterface::getExecutableDir() {
     return std::string(buffer);  
 }
 
+const void* OSInterface::mapFile(const std::string& path, size_t& size) {
+	size = 0;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return NULL;
+	// The view keeps the mapping and file open until it is unmapped
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+		return NULL;
+	size = fileSize.QuadPart;
+	return data;
+}
+
+void OSInterface::unmapFile(const void* data, size_t) {
+	if (data)
+		UnmapViewOfFile(data);
+}
+
+void OSInterface::lowerThreadPriority() {
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+}
+
 void OSInterface::bringWindowToTop(sf::Window* w) {
 	if (w->isOpen())
 		return;
@@ -69,47 +122,51 @@ void OSInterface::bringWindowToTop(sf::Window* w) {
 	BringWindowToTop(hWnd);
 }
 
-bool OSInterface::setTransparency(sf::Window* w, const sf::Image& image) {
+bool OSInterface::keepWindowOnTop(sf::Window* w) {
 	HWND hWnd = w->getNativeHandle();
-	const sf::Uint8* pixelData = image.getPixelsPtr();
-
-	// Create a region with the size of the entire window
-	HRGN hRegion = CreateRectRgn(0, 0, image.getSize().x, image.getSize().y);
-
-	// Loop over the pixels in the image and for each pixel where the alpha component equals 0,
-	// we will remove that pixel from the region.
-	// As an optimization, we will combine adjacent transparent pixels on the same row and
-	// remove them together, instead of using "CreateRectRgn(x, y, x+1, y+1)" to define
-	// a region for each transparent pixel individually.
-	bool transparentPixelFound = false;
-	unsigned int rectLeft = 0;
-	for (unsigned int y = 0; y < image.getSize().y; y++) {
-		for (unsigned int x = 0; x < image.getSize().x; x++) {
-			const bool isTransparentPixel = (pixelData[y * image.getSize().x * 4 + x * 4 + 3] == 0);
-			if (isTransparentPixel && !transparentPixelFound) {
-				transparentPixelFound = true;
-				rectLeft = x;
-			} 
-			else if (!isTransparentPixel && transparentPixelFound) {
-				HRGN hRegionPixel = CreateRectRgn(rectLeft, y, x, y+1);
-				CombineRgn(hRegion, hRegion, hRegionPixel, RGN_XOR);
-				DeleteObject(hRegionPixel);
-				transparentPixelFound = false;
-			}
-		}
+	if (!w->isOpen() || topmost.count(hWnd))
+		return false;
+	SetWindowPos(hWnd, HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+	topmost.insert(hWnd);
+	return true;
+}
 
-		if (transparentPixelFound) {
-			HRGN hRegionPixel = CreateRectRgn(rectLeft, y, image.getSize().x, y+1);
-			CombineRgn(hRegion, hRegion, hRegionPixel, RGN_XOR);
-			DeleteObject(hRegionPixel);
-			transparentPixelFound = false;
-		}
+bool OSInterface::setTransparency(sf::Window* w, const AlphaSpans& spans) {
+	HWND hWnd = w->getNativeHandle();
+
+	// Build the region from the opaque runs in one go rather than combining a region
+	// per run. The rectangles follow the header in the same buffer
+	std::vector<char> buffer(sizeof(RGNDATAHEADER) + spans.getSpanCount() * sizeof(RECT));
+	auto data = reinterpret_cast<RGNDATA*>(buffer.data());
+	data->rdh.dwSize = sizeof(RGNDATAHEADER);
+	data->rdh.iType = RDH_RECTANGLES;
+	data->rdh.nCount = spans.getSpanCount();
+	data->rdh.nRgnSize = spans.getSpanCount() * sizeof(RECT);
+	SetRect(&data->rdh.rcBound, 0, 0, spans.getWidth(), spans.getHeight());
+	auto rects = reinterpret_cast<RECT*>(data->Buffer);
+	for (unsigned int y = 0; y < spans.getHeight(); y++) {
+		for (auto span = spans.rowBegin(y); span != spans.rowEnd(y); span++)
+			SetRect(rects++, span->left, y, span->right, y + 1);
 	}
+	HRGN hRegion = ExtCreateRegion(NULL, buffer.size(), data);
 
-	SetWindowRgn(hWnd, hRegion, true);
-	DeleteObject(hRegion);
+	// The system owns the region once it has been set
+	if (!SetWindowRgn(hWnd, hRegion, true)) {
+		DeleteObject(hRegion);
+		return false;
+	}
 	return true;
 }
+
+void OSInterface::benchmarkTransparency(sf::Window* w, const AlphaSpans& spans, unsigned int iterations) {
+	// There is only one way of setting the window region here
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+		setTransparency(w, spans);
+	auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	if (iterations > 0)
+		printf("%-10s %8.1f us/update\n", "region", elapsed / iterations);
+}
 #endif
 
 #ifdef SFML_SYSTEM_LINUX
@@ -118,15 +175,111 @@ bool OSInterface::setTransparency(sf::Window* w, const sf::Image& image) {
 #include <X11/Xatom.h>
 #include <unistd.h>  
 #include <limits.h>  
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <vector>
+
+// A single connection to the X server shared by every OSInterface call rather than
+// opening a new one (and re-interning atoms) each frame
+struct X11Context {
+	Display* display = NULL;
+	Atom wmState = 0;
+	Atom wmStateAbove = 0;
+	bool hasShape = false;
+	// Windows we have changed attributes on and still need to clean up
+	std::set<Window> windows;
+	// Windows kept on top and whether the window manager has lowered them since the last check
+	std::map<Window, bool> watched;
+	// The last shape set on each window in delta mode
+	std::map<Window, AlphaSpans> shapes;
+};
+
+static X11Context x11;
+
+static X11Context* x11Connect() {
+	if (x11.display)
+		return &x11;
+	x11.display = XOpenDisplay(NULL);
+	if (!x11.display)
+		throw std::runtime_error("Could not open X display");
+	x11.wmState = XInternAtom(x11.display, "_NET_WM_STATE", 1);
+	x11.wmStateAbove = XInternAtom(x11.display, "_NET_WM_STATE_ABOVE", 1);
+
+	// Setting the window shape requires the XShape extension
+	int eventBase;
+	int errorBase;
+	x11.hasShape = XShapeQueryExtension(x11.display, &eventBase, &errorBase);
+	return &x11;
+}
+
+// True if the window manager still has _NET_WM_STATE_ABOVE set on the window
+static bool x11HasAboveState(Window wnd) {
+	Atom type;
+	int format;
+	unsigned long count;
+	unsigned long remaining;
+	unsigned char* data = NULL;
+	if (XGetWindowProperty(x11.display, wnd, x11.wmState, 0, 64, False, XA_ATOM, &type, &format, &count, &remaining, &data) != Success || !data)
+		return false;
+	bool above = false;
+	auto atoms = reinterpret_cast<Atom*>(data);
+	for (unsigned long i = 0; i < count; i++) {
+		if (atoms[i] == x11.wmStateAbove)
+			above = true;
+	}
+	XFree(data);
+	return above;
+}
+
+// Drain the events for our watched windows and flag the ones that need raising again
+static void x11ProcessEvents() {
+	while (XPending(x11.display)) {
+		XEvent event;
+		XNextEvent(x11.display, &event);
+		auto watched = x11.watched.find(event.xany.window);
+		if (watched == x11.watched.end())
+			continue;
+		switch (event.type) {
+			case VisibilityNotify:
+				// Something has been stacked on top of us
+				if (event.xvisibility.state != VisibilityUnobscured)
+					watched->second = true;
+				break;
+			case PropertyNotify:
+				if (event.xproperty.atom == x11.wmState && !x11HasAboveState(watched->first))
+					watched->second = true;
+				break;
+			case MapNotify:
+				watched->second = true;
+				break;
+		}
+	}
+}
  
 void OSInterface::cleanupWindow(sf::Window* window) {
-	static Display* display = XOpenDisplay(NULL);
+	if (!x11.display)
+		return;
 	Window wnd = window->getNativeHandle();
-    XSetWindowAttributes attributes;
-    attributes.override_redirect = False;
-    XChangeWindowAttributes(display, wnd, CWOverrideRedirect, &attributes);
-	XFlush(display);
-	XCloseDisplay(display);
+	x11.watched.erase(wnd);
+	x11.shapes.erase(wnd);
+	if (wnd && x11.windows.erase(wnd)) {
+		XSetWindowAttributes attributes;
+		attributes.override_redirect = False;
+		XChangeWindowAttributes(x11.display, wnd, CWOverrideRedirect, &attributes);
+		XFlush(x11.display);
+	}
+
+	// Tear the connection down once the last window is gone
+	if (x11.windows.empty()) {
+		XCloseDisplay(x11.display);
+		x11 = X11Context();
+	}
 }
 
 std::string OSInterface::getExecutableDir() {  
@@ -141,26 +294,54 @@ std::string OSInterface::getExecutableDir() {
     return std::filesystem::path(buffer).parent_path().string();  
 }
 
+const void* OSInterface::mapFile(const std::string& path, size_t& size) {
+	size = 0;
+	int file = open(path.c_str(), O_RDONLY);
+	if (file == -1)
+		return NULL;
+	struct stat info;
+	if (fstat(file, &info) == -1 || info.st_size == 0) {
+		close(file);
+		return NULL;
+	}
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping holds its own reference to the file
+	close(file);
+	if (data == MAP_FAILED)
+		return NULL;
+	size = info.st_size;
+	return data;
+}
+
+void OSInterface::unmapFile(const void* data, size_t size) {
+	if (data)
+		munmap((void*)data, size);
+}
+
+// Linux applies nice values to single threads when given a thread id
+void OSInterface::lowerThreadPriority() {
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+}
+
 void OSInterface::bringWindowToTop(sf::Window* w) {
 	// if (w->isOpen())
 	// 	return;
 	Window wnd = w->getNativeHandle();
-	Display* display = XOpenDisplay(NULL);
-	
-	// Multiple atoms for persistent window behavior
-    Atom stateAtom = XInternAtom(display, "_NET_WM_STATE", 1);
-    //Atom stickyAtom = XInternAtom(display, "_NET_WM_STATE_STICKY", 1);
-    Atom alwaysOnTopAtom = XInternAtom(display, "_NET_WM_STATE_ABOVE", 1);
-    //Atom keepAboveAtom = XInternAtom(display, "_NET_WM_STATE_KEEP_ABOVE", 1);
+	// Closed windows no longer have a native handle
+	if (!wnd)
+		return;
+	auto context = x11Connect();
+	Display* display = context->display;
+	context->windows.insert(wnd);
 
     // Prepare client message
     XClientMessageEvent event;
     event.type = ClientMessage;
     event.window = wnd;
-    event.message_type = stateAtom;
+    event.message_type = context->wmState;
     event.format = 32;
     event.data.l[0] = 1;
-    event.data.l[1] = alwaysOnTopAtom;
+    event.data.l[1] = context->wmStateAbove;
     event.data.l[2] = 0;
     event.data.l[3] = 0;
     event.data.l[4] = 0;
@@ -175,59 +356,46 @@ void OSInterface::bringWindowToTop(sf::Window* w) {
     XChangeWindowAttributes(display, wnd, CWOverrideRedirect, &attributes);
 
     XFlush(display);
-	XCloseDisplay(display);
 }
 
-#undef None
-#undef Status
-
-bool OSInterface::setTransparency(sf::Window* w, const sf::Image& image) {
+bool OSInterface::keepWindowOnTop(sf::Window* w) {
 	Window wnd = w->getNativeHandle();
-	Display* display = XOpenDisplay(NULL);
-
-	// Setting the window shape requires the XShape extension
-	int event_base;
-	int error_base;
-	if (!XShapeQueryExtension(display, &event_base, &error_base)) {
-		XCloseDisplay(display);
+	if (!wnd)
 		return false;
+	auto context = x11Connect();
+	if (!context->watched.count(wnd)) {
+		// Listen for the window manager restacking or changing the state of the window
+		// rather than re-asserting it every frame
+		XSelectInput(context->display, wnd, StructureNotifyMask | PropertyChangeMask | VisibilityChangeMask);
+		context->watched[wnd] = true;
 	}
+	x11ProcessEvents();
+	if (!context->watched[wnd])
+		return false;
+	context->watched[wnd] = false;
+	bringWindowToTop(w);
+	return true;
+}
 
-	const auto pixelData = image.getPixelsPtr();
+#undef None
+#undef Status
+
+// Draws the transparent runs into a 1-bit pixmap and uses it as the window mask.
+// This costs one request per transparent run
+static void x11ShapePixmap(Window wnd, const AlphaSpans& spans) {
+	Display* display = x11.display;
 
 	// Create a black and white pixmap that has the size of the window
-	Pixmap pixmap = XCreatePixmap(display, wnd, image.getSize().x, image.getSize().y, 1);
+	Pixmap pixmap = XCreatePixmap(display, wnd, spans.getWidth(), spans.getHeight(), 1);
 	GC gc = XCreateGC(display, pixmap, 0, NULL);
 
-	// Make the entire pixmap white
-	XSetForeground(display, gc, 1);
-	XFillRectangle(display, pixmap, gc, 0, 0, image.getSize().x, image.getSize().y);
-
-	// Loop over the pixels in the image and change the color of the pixmap to black
-	// for each pixel where the alpha component equals 0.
-	// As an optimization, we will combine adjacent transparent pixels on the same row and
-	// draw them together, instead of calling "XFillRectangle(display, pixmap, gc, x, y, 1, 1)"
-	// for each transparent pixel individually.
+	// Make the entire pixmap black, then draw each opaque run in white
 	XSetForeground(display, gc, 0);
-	bool transparentPixelFound = false;
-	unsigned int rectLeft = 0;
-	for (unsigned int y = 0; y < image.getSize().y; y++) {
-		for (unsigned int x = 0; x < image.getSize().x; x++) {
-			const bool isTransparentPixel = (pixelData[y * image.getSize().x * 4 + x * 4 + 3] == 0);
-			if (isTransparentPixel && !transparentPixelFound) {
-				transparentPixelFound = true;
-				rectLeft = x;
-			}
-			else if (!isTransparentPixel && transparentPixelFound) {
-				XFillRectangle(display, pixmap, gc, rectLeft, y, x - rectLeft, 1);
-				transparentPixelFound = false;
-			}
-		}
-
-		if (transparentPixelFound) {
-			XFillRectangle(display, pixmap, gc, rectLeft, y, image.getSize().x - rectLeft, 1);
-			transparentPixelFound = false;
-		}
+	XFillRectangle(display, pixmap, gc, 0, 0, spans.getWidth(), spans.getHeight());
+	XSetForeground(display, gc, 1);
+	for (unsigned int y = 0; y < spans.getHeight(); y++) {
+		for (auto span = spans.rowBegin(y); span != spans.rowEnd(y); span++)
+			XFillRectangle(display, pixmap, gc, span->left, y, span->right - span->left, 1);
 	}
 
 	// Use the black and white pixmap to define the shape of the window. All pixels that are
@@ -237,8 +405,181 @@ bool OSInterface::setTransparency(sf::Window* w, const sf::Image& image) {
 	// Free resources
 	XFreeGC(display, gc);
 	XFreePixmap(display, pixmap);
-	XFlush(display);
-	XCloseDisplay(display);
+}
+
+// Collects runs into rectangles, added row by row in x order. Runs that are identical to
+// ones on the previous row extend that rectangle down instead of starting a new one, so
+// solid areas collapse into a handful of rectangles
+struct X11Rectangles {
+	std::vector<XRectangle> rects;
+	// Indices of the rectangles that reached the previous row, in x order
+	std::vector<size_t> previousRow;
+	std::vector<size_t> currentRow;
+	size_t previous = 0;
+
+	void add(unsigned int left, unsigned int right, unsigned int y) {
+		// Both rows are in x order so the previous row only needs walking once
+		while (previous < previousRow.size() && rects[previousRow[previous]].x < (short)left)
+			previous++;
+		if (previous < previousRow.size() && rects[previousRow[previous]].x == (short)left && rects[previousRow[previous]].width == right - left) {
+			rects[previousRow[previous]].height++;
+			currentRow.push_back(previousRow[previous]);
+			previous++;
+			return;
+		}
+		rects.push_back(XRectangle{ (short)left, (short)y, (unsigned short)(right - left), 1 });
+		currentRow.push_back(rects.size() - 1);
+	}
+
+	void endRow() {
+		previousRow.swap(currentRow);
+		currentRow.clear();
+		previous = 0;
+	}
+};
+
+// Submits the opaque runs as rectangles in a single request
+static void x11ShapeRectangles(Window wnd, const AlphaSpans& spans) {
+	X11Rectangles rectangles;
+	for (unsigned int y = 0; y < spans.getHeight(); y++) {
+		for (auto span = spans.rowBegin(y); span != spans.rowEnd(y); span++)
+			rectangles.add(span->left, span->right, y);
+		rectangles.endRow();
+	}
+
+	// Rectangles are created in the order of their top row and then x
+	auto& rects = rectangles.rects;
+	XShapeCombineRectangles(x11.display, wnd, ShapeBounding, 0, 0, rects.data(), rects.size(), ShapeSet, YXSorted);
+}
+
+// Sweeps the edges of a row of the old and new shapes in x order, adding the runs only
+// the new one covers to added and the runs only the old one covers to removed
+static void x11DiffRow(const AlphaSpan* old, const AlphaSpan* oldEnd, const AlphaSpan* now, const AlphaSpan* nowEnd, unsigned int y, X11Rectangles& added, X11Rectangles& removed) {
+	bool inOld = false;
+	bool inNow = false;
+	unsigned int start = 0;
+	while (old != oldEnd || now != nowEnd) {
+		unsigned int oldEdge = old == oldEnd ? UINT_MAX : inOld ? old->right : old->left;
+		unsigned int nowEdge = now == nowEnd ? UINT_MAX : inNow ? now->right : now->left;
+		unsigned int x = std::min(oldEdge, nowEdge);
+		if (x > start && inOld != inNow)
+			(inNow ? added : removed).add(start, x, y);
+		if (oldEdge == x) {
+			if (inOld)
+				old++;
+			inOld = !inOld;
+		}
+		if (nowEdge == x) {
+			if (inNow)
+				now++;
+			inNow = !inNow;
+		}
+		start = x;
+	}
+}
+
+// Adds what is newly opaque to the window's current shape and takes away what is newly
+// transparent, so an animation only costs the X server the pixels that changed. The
+// additions go first, so nothing opaque in both shapes is ever clipped in between
+static void x11ShapeDelta(Window wnd, const AlphaSpans& spans) {
+	auto previous = x11.shapes.find(wnd);
+	if (previous == x11.shapes.end() || previous->second.getWidth() != spans.getWidth() || previous->second.getHeight() != spans.getHeight()) {
+		x11ShapeRectangles(wnd, spans);
+		x11.shapes[wnd] = spans;
+		return;
+	}
+
+	const auto& old = previous->second;
+	X11Rectangles added;
+	X11Rectangles removed;
+	for (unsigned int y = 0; y < spans.getHeight(); y++) {
+		x11DiffRow(old.rowBegin(y), old.rowEnd(y), spans.rowBegin(y), spans.rowEnd(y), y, added, removed);
+		added.endRow();
+		removed.endRow();
+	}
+
+	// Past a point a fresh shape is less for the server to work through than the changes
+	if (added.rects.size() + removed.rects.size() > spans.getSpanCount()) {
+		x11ShapeRectangles(wnd, spans);
+	}
+	else {
+		if (!added.rects.empty())
+			XShapeCombineRectangles(x11.display, wnd, ShapeBounding, 0, 0, added.rects.data(), added.rects.size(), ShapeUnion, YXSorted);
+		if (!removed.rects.empty())
+			XShapeCombineRectangles(x11.display, wnd, ShapeBounding, 0, 0, removed.rects.data(), removed.rects.size(), ShapeSubtract, YXSorted);
+	}
+	previous->second = spans;
+}
+
+static void x11Shape(Window wnd, const AlphaSpans& spans, OSInterface::ShapeMode mode) {
+	if (mode == OSInterface::ShapeMode::Delta) {
+		x11ShapeDelta(wnd, spans);
+		return;
+	}
+	// The shape delta mode knows about is no longer the one on the window
+	x11.shapes.erase(wnd);
+	if (mode == OSInterface::ShapeMode::Rectangles)
+		x11ShapeRectangles(wnd, spans);
+	else
+		x11ShapePixmap(wnd, spans);
+}
+
+bool OSInterface::setTransparency(sf::Window* w, const AlphaSpans& spans) {
+	Window wnd = w->getNativeHandle();
+	if (!wnd)
+		return false;
+	auto context = x11Connect();
+	if (!context->hasShape)
+		return false;
+	context->windows.insert(wnd);
+	x11Shape(wnd, spans, shapeMode);
+	XFlush(context->display);
 	return true;
 }
+
+void OSInterface::benchmarkTransparency(sf::Window* w, const AlphaSpans& spans, unsigned int iterations) {
+	Window wnd = w->getNativeHandle();
+	auto context = x11Connect();
+	if (!wnd || !context->hasShape || iterations == 0)
+		return;
+	context->windows.insert(wnd);
+	// Delta mode sends nothing for a shape that has not changed, so every mode goes back
+	// and forth between the shape and the shape with a small square cut out, like an eye
+	// blinking, near the start of its bottom row
+	AlphaSpans blinked(spans.getWidth());
+	unsigned int size = 8;
+	unsigned int top = spans.getHeight() > size ? spans.getHeight() - size : 0;
+	unsigned int left = spans.getHeight() > 0 && spans.rowBegin(spans.getHeight() - 1) != spans.rowEnd(spans.getHeight() - 1) ? spans.rowBegin(spans.getHeight() - 1)->left : 0;
+	for (unsigned int y = 0; y < spans.getHeight(); y++) {
+		blinked.addRow();
+		for (auto span = spans.rowBegin(y); span != spans.rowEnd(y); span++) {
+			if (y < top || span->right <= left || span->left >= left + size) {
+				blinked.addSpan(span->left, span->right);
+				continue;
+			}
+			if (span->left < left)
+				blinked.addSpan(span->left, left);
+			if (span->right > left + size)
+				blinked.addSpan(left + size, span->right);
+		}
+	}
+
+	const std::pair<const char*, ShapeMode> modes[] = { { "pixmap", ShapeMode::Pixmap }, { "rectangles", ShapeMode::Rectangles }, { "delta", ShapeMode::Delta } };
+	for (const auto& mode : modes) {
+		x11Shape(wnd, spans, mode.second);
+		// Wait for everything queued so far so each mode is timed end to end
+		XSync(context->display, False);
+		unsigned long firstRequest = XNextRequest(context->display);
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < iterations; i++)
+			x11Shape(wnd, i % 2 ? spans : blinked, mode.second);
+		XSync(context->display, False);
+		auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		// Minus the GetInputFocus round trip XSync makes
+		unsigned long requests = XNextRequest(context->display) - firstRequest - 1;
+		printf("%-10s %8.1f us/update %8.1f requests/update\n", mode.first, elapsed / iterations, (double)requests / iterations);
+	}
+	x11Shape(wnd, spans, shapeMode);
+	XFlush(context->display);
+}
 #endif
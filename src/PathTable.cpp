@@ -0,0 +1,64 @@
+#include <PathTable.h>
+#include <cassert>
+
+size_t PathTable::add(std::string_view path) {
+	// Split after the last separator of either kind
+	size_t split = path.size();
+	while (split > 0 && path[split - 1] != '/' && path[split - 1] != '\\')
+		split--;
+	Record record;
+	record.directory = _internDirectory(path.substr(0, split));
+	record.offset = _names.size();
+	record.length = path.size() - split;
+	_names.insert(_names.end(), path.begin() + split, path.end());
+	_records.push_back(record);
+	return _records.size() - 1;
+}
+
+uint32_t PathTable::_internDirectory(std::string_view directory) {
+	if (_lastDirectory != UINT32_MAX && _directories[_lastDirectory] == directory)
+		return _lastDirectory;
+	auto found = _directoryIds.find(directory);
+	if (found != _directoryIds.end()) {
+		_lastDirectory = found->second;
+		return _lastDirectory;
+	}
+	_lastDirectory = _directories.size();
+	_directories.emplace_back(directory);
+	// Keys view the stored strings, which a deque never moves
+	_directoryIds.emplace(_directories.back(), _lastDirectory);
+	return _lastDirectory;
+}
+
+std::string PathTable::get(size_t index) const {
+	auto directory = getDirectory(index);
+	auto filename = getFilename(index);
+	std::string path;
+	path.reserve(directory.size() + filename.size());
+	path.append(directory);
+	path.append(filename);
+	return path;
+}
+
+std::string_view PathTable::getDirectory(size_t index) const {
+	assert(index < _records.size());
+	return _directories[_records[index].directory];
+}
+
+std::string_view PathTable::getFilename(size_t index) const {
+	assert(index < _records.size());
+	auto& record = _records[index];
+	return std::string_view(_names.data() + record.offset, record.length);
+}
+
+size_t PathTable::size() const {
+	return _records.size();
+}
+
+void PathTable::clear() {
+	_records.clear();
+	_names.clear();
+	_directories.clear();
+	_directoryIds.clear();
+	_lastDirectory = UINT32_MAX;
+}
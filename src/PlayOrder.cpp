@@ -0,0 +1,167 @@
+#include <PlayOrder.h>
+#include <cassert>
+
+// Oldest history is forgotten past this so a long session does not grow without bound
+static const size_t MAX_HISTORY = 10000;
+
+PlayOrder::PlayOrder() : _random(std::random_device()()) {
+}
+
+void PlayOrder::reset(size_t count, size_t start) {
+	assert(count > 0 && start < count);
+	_count = count;
+	_history.assign(1, start);
+	_position = 0;
+	_hasPending = false;
+	_restartShuffle();
+}
+
+void PlayOrder::add(size_t count) {
+	// New tracks land in the part of the shuffle still to be drawn, so a track already
+	// drawn stays next. In order, the next track may be one of the new ones
+	_count += count;
+	if (!_shuffle || _pending == NONE)
+		_hasPending = false;
+}
+
+void PlayOrder::setShuffle(bool shuffle) {
+	if (shuffle == _shuffle)
+		return;
+	_shuffle = shuffle;
+	_hasPending = false;
+	_restartShuffle();
+}
+
+bool PlayOrder::getShuffle() const {
+	return _shuffle;
+}
+
+void PlayOrder::setRepeat(Repeat repeat) {
+	_repeat = repeat;
+	// Reaching the end may now go round again
+	if (_pending == NONE)
+		_hasPending = false;
+}
+
+PlayOrder::Repeat PlayOrder::getRepeat() const {
+	return _repeat;
+}
+
+size_t PlayOrder::current() const {
+	return _history[_position];
+}
+
+size_t PlayOrder::_slot(size_t position) {
+	auto found = _swapped.find(position);
+	return found == _swapped.end() ? position : found->second;
+}
+
+size_t PlayOrder::_slotOf(size_t track) {
+	auto found = _slots.find(track);
+	return found == _slots.end() ? track : found->second;
+}
+
+void PlayOrder::_swap(size_t a, size_t b) {
+	size_t trackA = _slot(a);
+	size_t trackB = _slot(b);
+	_swapped[a] = trackB;
+	_slots[trackB] = a;
+	_swapped[b] = trackA;
+	_slots[trackA] = b;
+}
+
+// Begins a new round with the current track counted as already drawn
+void PlayOrder::_restartShuffle() {
+	_swapped.clear();
+	_slots.clear();
+	_drawn = 0;
+	if (_count == 0)
+		return;
+	if (current() != 0)
+		_swap(0, current());
+	_drawn = 1;
+}
+
+// The track after the current one, without looking at history
+size_t PlayOrder::_draw() {
+	if (!_shuffle) {
+		size_t track = current() + 1;
+		if (track < _count)
+			return track;
+		return _repeat == Repeat::All ? 0 : NONE;
+	}
+	if (_drawn == _count) {
+		if (_repeat != Repeat::All)
+			return NONE;
+		_restartShuffle();
+		if (_count == 1)
+			return current();
+	}
+	// One step of Fisher-Yates: swap a random undrawn slot into the next position
+	std::uniform_int_distribution<size_t> pick(_drawn, _count - 1);
+	_swap(pick(_random), _drawn);
+	return _slot(_drawn++);
+}
+
+size_t PlayOrder::peekNext() {
+	if (_repeat == Repeat::One)
+		return current();
+	if (_position + 1 < _history.size())
+		return _history[_position + 1];
+	if (!_hasPending) {
+		_pending = _draw();
+		_hasPending = true;
+	}
+	return _pending;
+}
+
+bool PlayOrder::advance() {
+	if (_repeat == Repeat::One)
+		return true;
+	return next();
+}
+
+bool PlayOrder::next() {
+	// Going forward again after stepping back replays the same tracks
+	if (_position + 1 < _history.size()) {
+		_position++;
+		return true;
+	}
+	size_t track = _hasPending ? _pending : _draw();
+	_hasPending = false;
+	if (track == NONE)
+		return false;
+	_history.push_back(track);
+	_position++;
+	if (_history.size() > MAX_HISTORY) {
+		_history.erase(_history.begin(), _history.begin() + MAX_HISTORY / 2);
+		_position -= MAX_HISTORY / 2;
+	}
+	return true;
+}
+
+bool PlayOrder::previous() {
+	if (_position == 0)
+		return false;
+	_position--;
+	return true;
+}
+
+void PlayOrder::jump(size_t index) {
+	assert(index < _count);
+	if (_shuffle) {
+		// A draw that was only peeked at is always the latest, so it goes back to be drawn
+		// again later this round
+		if (_hasPending && _pending != NONE)
+			_drawn--;
+		// The picked track counts as drawn, so it does not come up again this round
+		size_t position = _slotOf(index);
+		if (position >= _drawn)
+			_swap(position, _drawn++);
+	}
+	// Anything that had been stepped back over is replaced by the new track
+	_history.resize(_position + 1);
+	_history.push_back(index);
+	_position++;
+	_hasPending = false;
+}
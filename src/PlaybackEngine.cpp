@@ -0,0 +1,275 @@
+#include <PlaybackEngine.h>
+#include <AudioKernels.h>
+#include <algorithm>
+#include <chrono>
+
+// About three seconds of stereo 44.1kHz audio decoded ahead
+static const size_t RING_SAMPLES = 1 << 18;
+// Roughly 100ms per chunk handed to the audio device
+static const size_t CHUNK_SAMPLES = 8192;
+static const size_t DECODE_SAMPLES = 4096;
+// A few chunks, so the tap can be read at the frame rate however the device asks for chunks
+static const size_t TAP_SAMPLES = CHUNK_SAMPLES * 4;
+// Frames of silence played if the decoder ever falls behind, so the stream keeps going
+static const size_t UNDERRUN_FRAMES = 256;
+// The audio callback never signals the decoder, so it checks back this often for room
+static const std::int64_t POLL_MICROSECONDS = 20000;
+
+PlaybackEngine::PlaybackEngine() : _samples(RING_SAMPLES), _trackStarts(16), _tap(TAP_SAMPLES) {
+	_buffer.resize(CHUNK_SAMPLES);
+	_decoder = std::thread(&PlaybackEngine::_decode, this);
+}
+
+PlaybackEngine::~PlaybackEngine() {
+	stop();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_condition.notify_all();
+	_decoder.join();
+}
+
+bool PlaybackEngine::open(const std::string& path, float gain) {
+	stop();
+	auto track = _load(path, gain);
+	if (!track)
+		return false;
+	std::unique_lock<std::mutex> lock(_mutex);
+	_pauseDecoder(lock);
+	_generation++;
+	_queued.clear();
+	_next.reset();
+	_spliced.clear();
+	_current = std::move(track);
+	// The stream is stopped, so nothing is reading the buffers
+	_samples.clear();
+	size_t start;
+	while (_trackStarts.pop(start));
+	_written = 0;
+	_played = 0;
+	// The stream counts from zero again once it is initialised
+	_base = 0;
+	_trackStart = 0;
+	_exhausted = false;
+	_endOfStream = false;
+	// Stopping seeks back to the start, which may have flagged a change of its own
+	_trackChanged = false;
+	unsigned int channelCount = _current->file.getChannelCount();
+	unsigned int sampleRate = _current->file.getSampleRate();
+	auto channelMap = _current->file.getChannelMap();
+	_resumeDecoder(lock);
+	lock.unlock();
+	initialize(channelCount, sampleRate, channelMap);
+	return true;
+}
+
+void PlaybackEngine::queue(const std::string& path, float gain) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	// Whatever was queued before is dropped, so an empty path leaves nothing queued
+	_generation++;
+	_queued = path;
+	_queuedGain = gain;
+	_next.reset();
+	_condition.notify_all();
+}
+
+bool PlaybackEngine::pollTrackChanged() {
+	return _trackChanged.exchange(false);
+}
+
+sf::Time PlaybackEngine::getTrackOffset() {
+	std::int64_t rate = (std::int64_t)getSampleRate() * getChannelCount();
+	if (rate == 0)
+		return sf::Time::Zero;
+	return getPlayingOffset() - sf::microseconds(_trackStart * 1000000 / rate);
+}
+
+void PlaybackEngine::setTapEnabled(bool enabled) {
+	_tapEnabled = enabled;
+}
+
+size_t PlaybackEngine::readTap(std::int16_t* samples, size_t count) {
+	return _tap.read(samples, count);
+}
+
+size_t PlaybackEngine::getTapSize() const {
+	return _tap.size();
+}
+
+bool PlaybackEngine::onGetData(Chunk& data) {
+	// Never locks or waits, everything here comes out of the ring buffers
+	size_t count = _samples.read(_buffer.data(), _buffer.size());
+	if (count == 0 && _endOfStream) {
+		// The last samples may have landed between the read and the flag being set
+		count = _samples.read(_buffer.data(), _buffer.size());
+		if (count == 0)
+			return false;
+	}
+	if (count == 0) {
+		count = UNDERRUN_FRAMES * getChannelCount();
+		std::fill(_buffer.begin(), _buffer.begin() + count, 0);
+		// The stream counts the silence as played, so the current track starts that much
+		// later in its offset and so does everything after it
+		_base -= count;
+		_trackStart += count;
+	}
+	else {
+		_played += count;
+	}
+
+	size_t start;
+	while (_trackStarts.peek(start) && _played >= start) {
+		_trackStarts.pop(start);
+		_trackStart = (std::int64_t)start - _base;
+		_trackChanged = true;
+	}
+
+	// Whole chunks only, so the reader never ends up part way through a frame
+	if (_tapEnabled && _tap.space() >= count)
+		_tap.write(_buffer.data(), count);
+
+	data.samples = _buffer.data();
+	data.sampleCount = count;
+	return true;
+}
+
+void PlaybackEngine::onSeek(sf::Time timeOffset) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_pauseDecoder(lock);
+	// If the decoder has already moved on to the queued track, the one being heard is the
+	// track it moved on from before the first start not yet reached. Seek in that one, with
+	// the track after it lined up to follow again
+	size_t pending = _trackStarts.size();
+	if (pending > 0 && pending <= _spliced.size()) {
+		size_t audible = _spliced.size() - pending;
+		_next = pending == 1 ? std::move(_current) : std::move(_spliced[audible + 1]);
+		_next->file.seek(sf::Time::Zero);
+		_current = std::move(_spliced[audible]);
+		_trackStarts.clear();
+	}
+	_spliced.clear();
+	if (_current) {
+		// Anything decoded ahead no longer lines up with the file position
+		_current->file.seek(timeOffset);
+		_samples.clear();
+		_exhausted = false;
+		_endOfStream = false;
+		// Only left if the track moved on from is gone, in which case the queued track is
+		// the one being seeked in
+		size_t start;
+		while (_trackStarts.pop(start))
+			_trackChanged = true;
+		_played = _written;
+		// The stream counts on from the seek position within this track
+		std::int64_t channels = _current->file.getChannelCount();
+		_base = (std::int64_t)_written - timeOffset.asMicroseconds() * _current->file.getSampleRate() / 1000000 * channels;
+		_trackStart = 0;
+	}
+	_resumeDecoder(lock);
+}
+
+void PlaybackEngine::_decode() {
+	std::vector<std::int16_t> block(DECODE_SAMPLES);
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_quit) {
+		if (_pause) {
+			_paused = true;
+			_condition.notify_all();
+			_condition.wait(lock, [this]() { return !_pause || _quit; });
+			_paused = false;
+			continue;
+		}
+
+		// Open the queued track straight away so it is ready long before it is needed
+		if (!_queued.empty()) {
+			auto path = std::move(_queued);
+			_queued.clear();
+			float gain = _queuedGain;
+			unsigned int generation = _generation;
+			lock.unlock();
+			auto track = _load(path, gain);
+			lock.lock();
+			if (generation == _generation)
+				_next = std::move(track);
+			continue;
+		}
+
+		if (_exhausted && !_endOfStream) {
+			// Carry straight on into the queued track if the stream can. Otherwise the
+			// stream ends so the next track can be opened with its own format. If nothing
+			// has been queued yet, wait for it for as long as there is audio left to play
+			if (_next && _sameFormat(_current.get(), _next.get())) {
+				_trackStarts.push(_written);
+				// Anything older than the starts still waiting to be reached has played out
+				_spliced.push_back(std::move(_current));
+				while (_spliced.size() > _trackStarts.size())
+					_spliced.pop_front();
+				_current = std::move(_next);
+				_exhausted = false;
+			}
+			else if (_next || _samples.size() < block.size()) {
+				_endOfStream = true;
+			}
+			else {
+				// Sleep until what is left would have played down to the last block, unless
+				// a track is queued before then
+				std::int64_t rate = (std::int64_t)_current->file.getSampleRate() * _current->file.getChannelCount();
+				std::int64_t left = (std::int64_t)(_samples.size() - block.size()) * 1000000 / rate;
+				_condition.wait_for(lock, std::chrono::microseconds(std::max(left, POLL_MICROSECONDS)),
+					[this]() { return _pause || _quit || !_queued.empty(); });
+			}
+			continue;
+		}
+
+		if (!_current || _endOfStream) {
+			// Nothing to decode until a track is opened, seeked in or queued
+			_condition.wait(lock, [this]() { return _pause || _quit || !_queued.empty(); });
+			continue;
+		}
+
+		if (_samples.space() < block.size()) {
+			_condition.wait_for(lock, std::chrono::microseconds(POLL_MICROSECONDS));
+			continue;
+		}
+
+		// Decode without holding the lock. Anything that wants to change the tracks has
+		// to pause the decoder first, which waits for this to finish
+		lock.unlock();
+		size_t count = _current->file.read(block.data(), block.size());
+		if (_current->gain != 1)
+			AudioKernels::scaleInt16(block.data(), count, _current->gain);
+		_written += _samples.write(block.data(), count);
+		lock.lock();
+		if (count < block.size())
+			_exhausted = true;
+	}
+}
+
+void PlaybackEngine::_pauseDecoder(std::unique_lock<std::mutex>& lock) {
+	_pause = true;
+	_condition.notify_all();
+	_condition.wait(lock, [this]() { return _paused; });
+}
+
+void PlaybackEngine::_resumeDecoder(std::unique_lock<std::mutex>& lock) {
+	_pause = false;
+	lock.unlock();
+	_condition.notify_all();
+	lock.lock();
+}
+
+std::unique_ptr<PlaybackEngine::Track> PlaybackEngine::_load(const std::string& path, float gain) {
+	auto track = std::make_unique<Track>();
+	track->path = path;
+	track->gain = gain;
+	if (!track->file.openFromFile(path))
+		return NULL;
+	return track;
+}
+
+bool PlaybackEngine::_sameFormat(const Track* a, const Track* b) {
+	return a->file.getChannelCount() == b->file.getChannelCount()
+		&& a->file.getSampleRate() == b->file.getSampleRate()
+		&& a->file.getChannelMap() == b->file.getChannelMap();
+}
@@ -0,0 +1,190 @@
+#include <Playlist.h>
+#include <OSInterface.h>
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+// Size of each read from the playlist file. Lines are parsed straight out of this buffer
+static const size_t READ_BUFFER = 64 * 1024;
+
+static bool isAbsolute(const char* path, size_t length) {
+	if (length > 0 && (path[0] == '/' || path[0] == '\\'))
+		return true;
+	// Windows drive letter
+	if (length > 1 && path[1] == ':')
+		return true;
+	// URLs are passed through untouched
+	for (size_t i = 0; i + 2 < length && (isalnum((unsigned char)path[i]) || path[i] == '+' || path[i] == '-' || path[i] == '.'); i++)
+		if (path[i + 1] == ':' && path[i + 2] == '/')
+			return true;
+	return false;
+}
+
+bool Playlist::load(const std::string& path) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	clear();
+	// Relative entries are relative to the directory the playlist is in
+	std::string base = std::filesystem::path(path).parent_path().string();
+	if (!base.empty())
+		base += '/';
+
+	std::vector<char> buffer(READ_BUFFER);
+	// Start of a line that ran off the end of the previous read
+	std::string partial;
+	bool first = true;
+	size_t count;
+	while ((count = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+		const char* start = buffer.data();
+		const char* end = start + count;
+		// Skip the UTF-8 byte order mark
+		if (first && count >= 3 && memcmp(start, "\xEF\xBB\xBF", 3) == 0)
+			start += 3;
+		first = false;
+		while (start < end) {
+			const char* newline = (const char*)memchr(start, '\n', end - start);
+			if (!newline) {
+				partial.append(start, end);
+				break;
+			}
+			if (partial.empty()) {
+				_parseLine(start, newline - start, base);
+			}
+			else {
+				partial.append(start, newline);
+				_parseLine(partial.data(), partial.size(), base);
+				partial.clear();
+			}
+			start = newline + 1;
+		}
+	}
+	if (!partial.empty())
+		_parseLine(partial.data(), partial.size(), base);
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+void Playlist::_parseLine(const char* line, size_t length, const std::string& base) {
+	// Trim whitespace and the carriage return from files written on Windows
+	while (length > 0 && isspace((unsigned char)line[length - 1]))
+		length--;
+	while (length > 0 && isspace((unsigned char)*line)) {
+		line++;
+		length--;
+	}
+	if (length == 0)
+		return;
+	if (line[0] == '#') {
+		// #EXTINF:<seconds>,<title>
+		if (length > 8 && memcmp(line, "#EXTINF:", 8) == 0) {
+			const char* comma = (const char*)memchr(line + 8, ',', length - 8);
+			_pendingDuration = atoi(line + 8);
+			if (comma)
+				_pendingTitle.assign(comma + 1, line + length);
+			else
+				_pendingTitle.clear();
+		}
+		return;
+	}
+	if (isAbsolute(line, length)) {
+		add(std::string_view(line, length), _pendingTitle, _pendingDuration);
+	}
+	else {
+		_scratch.assign(base);
+		_scratch.append(line, length);
+		add(_scratch, _pendingTitle, _pendingDuration);
+	}
+	_pendingTitle.clear();
+	_pendingDuration = -1;
+}
+
+bool Playlist::save(const std::string& path) const {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	fputs("#EXTM3U\n", file);
+	for (size_t i = 0; i < size(); i++) {
+		auto title = getTitle(i);
+		if (!title.empty() || getDuration(i) >= 0)
+			fprintf(file, "#EXTINF:%d,%.*s\n", getDuration(i), (int)title.size(), title.data());
+		auto directory = _paths.getDirectory(i);
+		auto filename = _paths.getFilename(i);
+		fwrite(directory.data(), 1, directory.size(), file);
+		fwrite(filename.data(), 1, filename.size(), file);
+		fputc('\n', file);
+	}
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+void Playlist::add(std::string_view path, std::string_view title, int duration) {
+	_paths.add(path);
+	_info.push_back(Info{ (uint32_t)_titles.size(), (uint32_t)title.size(), duration });
+	_titles.insert(_titles.end(), title.begin(), title.end());
+}
+
+void Playlist::clear() {
+	_paths.clear();
+	_info.clear();
+	_titles.clear();
+	_pendingTitle.clear();
+	_pendingDuration = -1;
+}
+
+size_t Playlist::size() const {
+	return _info.size();
+}
+
+bool Playlist::empty() const {
+	return _info.empty();
+}
+
+std::string Playlist::getPath(size_t index) const {
+	return _paths.get(index);
+}
+
+std::string_view Playlist::getTitle(size_t index) const {
+	assert(index < _info.size());
+	auto& info = _info[index];
+	return std::string_view(_titles.data() + info.titleOffset, info.titleLength);
+}
+
+int Playlist::getDuration(size_t index) const {
+	assert(index < _info.size());
+	return _info[index].duration;
+}
+
+std::string Playlist::getDirectory() {
+	auto directory = OSInterface::getConfigPath() + "/playlists";
+	if (!std::filesystem::exists(directory))
+		std::filesystem::create_directories(directory);
+	return directory;
+}
+
+bool Playlist::isPlaylistFile(const std::string& path) {
+	auto extension = std::filesystem::path(path).extension().string();
+	for (auto& c : extension)
+		c = tolower((unsigned char)c);
+	return extension == ".m3u" || extension == ".m3u8";
+}
+
+// Copies a playlist into the playlists directory as m3u8, with its relative paths made
+// absolute so it still works from there. A playlist already saved under the same name is
+// kept, with a number added to the new one. Returns the new path, or empty on failure
+std::string Playlist::import(const std::string& path) {
+	Playlist playlist;
+	if (!playlist.load(path))
+		return "";
+	auto name = getDirectory() + "/" + std::filesystem::path(path).stem().string();
+	auto destination = name + ".m3u8";
+	for (int copy = 2; std::filesystem::exists(destination); copy++)
+		destination = name + " (" + std::to_string(copy) + ").m3u8";
+	if (!playlist.save(destination))
+		return "";
+	return destination;
+}
@@ -0,0 +1,203 @@
+#include <ProceduralSource.h>
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265f;
+// Impulses beyond this are dropped rather than letting a burst of them pile up
+static const size_t MAX_IMPULSES = 32;
+
+ProceduralSource::ProceduralSource(Kind kind, unsigned int sampleRate, size_t blockSize, std::uint32_t seed) {
+	_kind = kind;
+	_sampleRate = sampleRate;
+	_blockSize = std::max<size_t>(blockSize, 4);
+	for (unsigned int i = 0; i < 4; i++)
+		_rng[i] = (seed + 1) * 2654435761u + i * 40503u + 1;
+	_noise.resize(_blockSize * 2);
+	_channel.resize(_blockSize);
+	_block.resize(_blockSize * 2);
+	_blockPosition = _block.size();
+}
+
+void ProceduralSource::read(float* out, size_t frames) {
+	size_t samples = frames * 2;
+	while (samples > 0) {
+		if (_blockPosition == _block.size()) {
+			_generateBlock();
+			_blockPosition = 0;
+		}
+		size_t count = std::min(samples, _block.size() - _blockPosition);
+		std::copy(_block.begin() + _blockPosition, _block.begin() + _blockPosition + count, out);
+		_blockPosition += count;
+		out += count;
+		samples -= count;
+	}
+}
+
+void ProceduralSource::_generateBlock() {
+	// Move the modulation a little towards a new random target every block
+	if (std::fabs(_modulation - _modulationTarget) < 0.01f)
+		_modulationTarget = _uniform();
+	float blockSeconds = (float)_blockSize / _sampleRate;
+	_modulation += (_modulationTarget - _modulation) * std::min(1.0f, blockSeconds * 0.3f);
+
+	// Layout of _block is planar here, left then right, and interleaved at the end
+	float* left = _block.data();
+	float* right = _block.data() + _blockSize;
+	for (unsigned int c = 0; c < 2; c++) {
+		float* out = c == 0 ? left : right;
+		_white(_channel.data());
+		switch (_kind) {
+			case Kind::Rain:
+				// Bright hiss of distant rain
+				_pink(_channel.data(), c);
+				for (size_t i = 0; i < _blockSize; i++)
+					out[i] = _channel[i] * 0.25f;
+				break;
+			case Kind::Wind: {
+				// Brown noise through a filter that opens up with each gust
+				_brown(_channel.data(), c);
+				_lowpass(_channel.data(), c, 150 + 650 * _modulation);
+				float gain = 0.3f + 0.7f * _modulation;
+				for (size_t i = 0; i < _blockSize; i++)
+					out[i] = _channel[i] * gain;
+				break;
+			}
+			case Kind::Fireplace:
+				// Low rumble under the crackles
+				_brown(_channel.data(), c);
+				_lowpass(_channel.data(), c, 300);
+				for (size_t i = 0; i < _blockSize; i++)
+					out[i] = _channel[i] * 0.6f;
+				break;
+			case Kind::Snow:
+				// Soft, muffled hush
+				_pink(_channel.data(), c);
+				_lowpass(_channel.data(), c, 400 + 200 * _modulation);
+				for (size_t i = 0; i < _blockSize; i++)
+					out[i] = _channel[i] * 0.35f;
+				break;
+		}
+	}
+
+	// Shared noise for the impulses, which are panned between the channels
+	_white(_noise.data());
+	_white(_noise.data() + _blockSize);
+	if (_kind == Kind::Rain)
+		_impulses(40, 0.002f, 0.012f, 0.05f, 0.35f);
+	else if (_kind == Kind::Fireplace)
+		_impulses(6 + 10 * _modulation, 0.0003f, 0.003f, 0.1f, 0.8f);
+
+	for (auto& impulse : _active) {
+		float amplitude = impulse.amplitude;
+		float leftGain = 1 - impulse.pan;
+		float rightGain = impulse.pan;
+		for (size_t i = impulse.start; i < _blockSize; i++) {
+			left[i] += _noise[i] * amplitude * leftGain;
+			right[i] += _noise[_blockSize + i] * amplitude * rightGain;
+			amplitude *= impulse.decay;
+		}
+		impulse.amplitude = amplitude;
+		impulse.start = 0;
+	}
+	// Anything that has died away is finished with
+	_active.erase(std::remove_if(_active.begin(), _active.end(), [](const Impulse& impulse) { return impulse.amplitude < 0.0005f; }), _active.end());
+
+	// Interleave into the stereo frames handed out by read
+	std::copy(_block.begin(), _block.end(), _noise.begin());
+	for (size_t i = 0; i < _blockSize; i++) {
+		_block[i * 2] = _noise[i];
+		_block[i * 2 + 1] = _noise[_blockSize + i];
+	}
+}
+
+// xorshift32 in four lanes, scaled to [-1, 1)
+void ProceduralSource::_white(float* out) {
+	std::uint32_t a = _rng[0], b = _rng[1], c = _rng[2], d = _rng[3];
+	size_t i = 0;
+	for (; i + 4 <= _blockSize; i += 4) {
+		a ^= a << 13; a ^= a >> 17; a ^= a << 5;
+		b ^= b << 13; b ^= b >> 17; b ^= b << 5;
+		c ^= c << 13; c ^= c >> 17; c ^= c << 5;
+		d ^= d << 13; d ^= d >> 17; d ^= d << 5;
+		out[i] = (std::int32_t)a * (1.0f / 2147483648.0f);
+		out[i + 1] = (std::int32_t)b * (1.0f / 2147483648.0f);
+		out[i + 2] = (std::int32_t)c * (1.0f / 2147483648.0f);
+		out[i + 3] = (std::int32_t)d * (1.0f / 2147483648.0f);
+	}
+	for (; i < _blockSize; i++) {
+		a ^= a << 13; a ^= a >> 17; a ^= a << 5;
+		out[i] = (std::int32_t)a * (1.0f / 2147483648.0f);
+	}
+	_rng[0] = a;
+	_rng[1] = b;
+	_rng[2] = c;
+	_rng[3] = d;
+}
+
+// Paul Kellet's economy pink noise filter, in place over white noise
+void ProceduralSource::_pink(float* samples, unsigned int channel) {
+	float* state = _pinkState[channel];
+	float b0 = state[0], b1 = state[1], b2 = state[2];
+	for (size_t i = 0; i < _blockSize; i++) {
+		float white = samples[i];
+		b0 = 0.99765f * b0 + white * 0.0990460f;
+		b1 = 0.96300f * b1 + white * 0.2965164f;
+		b2 = 0.57000f * b2 + white * 1.0526913f;
+		samples[i] = (b0 + b1 + b2 + white * 0.1848f) * 0.2f;
+	}
+	state[0] = b0;
+	state[1] = b1;
+	state[2] = b2;
+}
+
+// Leaky integrator over white noise, in place
+void ProceduralSource::_brown(float* samples, unsigned int channel) {
+	float state = _brownState[channel];
+	for (size_t i = 0; i < _blockSize; i++) {
+		state = (state + 0.02f * samples[i]) * (1.0f / 1.02f);
+		samples[i] = state * 3.5f;
+	}
+	_brownState[channel] = state;
+}
+
+// One pole low pass, in place
+void ProceduralSource::_lowpass(float* samples, unsigned int channel, float cutoff) {
+	float a = 1 - std::exp(-2 * PI * cutoff / _sampleRate);
+	float state = _lowpassState[channel];
+	for (size_t i = 0; i < _blockSize; i++) {
+		state += a * (samples[i] - state);
+		samples[i] = state;
+	}
+	_lowpassState[channel] = state;
+}
+
+// Starts new impulses in this block as a Poisson process of the given rate per second.
+// Each decays to around -60dB over a random length
+void ProceduralSource::_impulses(float rate, float minLength, float maxLength, float minAmplitude, float maxAmplitude) {
+	while (_nextImpulse < _blockSize) {
+		if (_active.size() < MAX_IMPULSES) {
+			float length = (minLength + (maxLength - minLength) * _uniform()) * _sampleRate;
+			_active.push_back(Impulse{
+				(size_t)_nextImpulse,
+				minAmplitude + (maxAmplitude - minAmplitude) * _uniform() * _uniform(),
+				std::pow(0.001f, 1.0f / std::max(length, 1.0f)),
+				_uniform(),
+			});
+		}
+		// Exponentially distributed gaps between impulses
+		_nextImpulse += -std::log(std::max(_uniform(), 1e-6f)) * _sampleRate / rate;
+	}
+	_nextImpulse -= _blockSize;
+}
+
+float ProceduralSource::_random() {
+	std::uint32_t& x = _rng[0];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return (std::int32_t)x * (1.0f / 2147483648.0f);
+}
+
+float ProceduralSource::_uniform() {
+	return _random() * 0.5f + 0.5f;
+}
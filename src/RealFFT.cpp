@@ -0,0 +1,114 @@
+#include <RealFFT.h>
+#include <cassert>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define REAL_FFT_SSE2
+#include <immintrin.h>
+#endif
+
+static const double PI = 3.14159265358979323846;
+
+RealFFT::RealFFT(size_t size) : _size(size), _half(size / 2) {
+	// Small enough sizes would leave no pass wide enough for the vector butterflies
+	assert(size >= 8 && (size & (size - 1)) == 0);
+	_re.resize(_half);
+	_im.resize(_half);
+
+	unsigned int bits = 0;
+	while (((size_t)1 << bits) < _half)
+		bits++;
+	_reversed.resize(_half);
+	for (size_t i = 0; i < _half; i++) {
+		size_t reversed = 0;
+		for (unsigned int bit = 0; bit < bits; bit++)
+			reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+		_reversed[i] = reversed;
+	}
+
+	_twiddleRe.resize(_half - 1);
+	_twiddleIm.resize(_half - 1);
+	for (size_t n = 1; n < _half; n *= 2) {
+		for (size_t j = 0; j < n; j++) {
+			double angle = -PI * j / n;
+			_twiddleRe[n - 1 + j] = (float)std::cos(angle);
+			_twiddleIm[n - 1 + j] = (float)std::sin(angle);
+		}
+	}
+
+	_splitRe.resize(_half + 1);
+	_splitIm.resize(_half + 1);
+	for (size_t k = 0; k <= _half; k++) {
+		double angle = -2 * PI * k / size;
+		_splitRe[k] = (float)std::cos(angle);
+		_splitIm[k] = (float)std::sin(angle);
+	}
+}
+
+size_t RealFFT::getSize() const {
+	return _size;
+}
+
+void RealFFT::forward(const float* in, float* re, float* im) {
+	// Even samples become the real parts and odd samples the imaginary parts
+	for (size_t i = 0; i < _half; i++) {
+		_re[_reversed[i]] = in[i * 2];
+		_im[_reversed[i]] = in[i * 2 + 1];
+	}
+	_butterflies();
+
+	// Bin k of the even and odd halves comes from bins k and half - k of the result, and
+	// the odd half is shifted by the twiddle before the two are added back together
+	for (size_t k = 0; k <= _half; k++) {
+		size_t a = k % _half;
+		size_t b = (_half - k) % _half;
+		float evenRe = (_re[a] + _re[b]) * 0.5f;
+		float evenIm = (_im[a] - _im[b]) * 0.5f;
+		float oddRe = (_im[a] + _im[b]) * 0.5f;
+		float oddIm = (_re[b] - _re[a]) * 0.5f;
+		re[k] = evenRe + _splitRe[k] * oddRe - _splitIm[k] * oddIm;
+		im[k] = evenIm + _splitRe[k] * oddIm + _splitIm[k] * oddRe;
+	}
+}
+
+// Radix 2 passes over the bit reversed input. The first two passes have fewer butterflies
+// per block than fit in a register, so only the later ones are vectorised
+void RealFFT::_butterflies() {
+	float* re = _re.data();
+	float* im = _im.data();
+	for (size_t n = 1; n < _half; n *= 2) {
+		const float* twiddleRe = _twiddleRe.data() + n - 1;
+		const float* twiddleIm = _twiddleIm.data() + n - 1;
+		for (size_t block = 0; block < _half; block += n * 2) {
+			size_t j = 0;
+#ifdef REAL_FFT_SSE2
+			for (; j + 4 <= n; j += 4) {
+				size_t a = block + j;
+				size_t b = a + n;
+				__m128 wr = _mm_loadu_ps(twiddleRe + j);
+				__m128 wi = _mm_loadu_ps(twiddleIm + j);
+				__m128 br = _mm_loadu_ps(re + b);
+				__m128 bi = _mm_loadu_ps(im + b);
+				__m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+				__m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+				__m128 ar = _mm_loadu_ps(re + a);
+				__m128 ai = _mm_loadu_ps(im + a);
+				_mm_storeu_ps(re + b, _mm_sub_ps(ar, tr));
+				_mm_storeu_ps(im + b, _mm_sub_ps(ai, ti));
+				_mm_storeu_ps(re + a, _mm_add_ps(ar, tr));
+				_mm_storeu_ps(im + a, _mm_add_ps(ai, ti));
+			}
+#endif
+			for (; j < n; j++) {
+				size_t a = block + j;
+				size_t b = a + n;
+				float tr = re[b] * twiddleRe[j] - im[b] * twiddleIm[j];
+				float ti = re[b] * twiddleIm[j] + im[b] * twiddleRe[j];
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
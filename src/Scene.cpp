@@ -0,0 +1,174 @@
+#include <Scene.h>
+#include <Button.h>
+#include <OSInterface.h>
+#include <GraphicsManager.h>
+#include <algorithm>
+#include <cmath>
+
+// Layouts whose masks are kept
+static const size_t MASK_CACHE_SIZE = 16;
+
+Scene::Scene(unsigned int width, unsigned int height) {
+	_width = width;
+	_height = height;
+}
+
+void Scene::add(sf::Sprite* sprite, bool visible) {
+	_add(sprite, NULL, visible);
+}
+
+void Scene::add(Button* button, bool visible) {
+	_add(button->getSprite(), button, visible);
+}
+
+void Scene::setVisible(sf::Sprite* sprite, bool visible) {
+	auto node = _find(sprite);
+	assert(node);
+	if (node->visible == visible)
+		return;
+	node->visible = visible;
+	invalidate();
+}
+
+void Scene::setVisible(Button* button, bool visible) {
+	setVisible(button->getSprite(), visible);
+}
+
+void Scene::invalidate() {
+	_shapeDirty = true;
+	_batchesDirty = true;
+	_redraw = true;
+}
+
+void Scene::requestRedraw() {
+	_redraw = true;
+}
+
+bool Scene::needsRedraw() {
+	_snapshot();
+	return _redraw;
+}
+
+bool Scene::updateShape(sf::Window* window) {
+	_snapshot();
+	if (!_shapeDirty)
+		return false;
+
+	OSInterface::setTransparency(window, _getMask());
+	_shapeDirty = false;
+	return true;
+}
+
+void Scene::benchmarkShape(sf::Window* window, unsigned int iterations) {
+	_snapshot();
+	OSInterface::benchmarkTransparency(window, _composeMask(), iterations);
+	_shapeDirty = true;
+}
+
+void Scene::draw(sf::RenderTarget* target) {
+	_snapshot();
+	if (_batchesDirty) {
+		_buildBatches();
+		_batchesDirty = false;
+	}
+	for (const auto& batch : _batches)
+		target->draw(batch.vertices, sf::RenderStates(batch.texture));
+
+	// Text uses the font's texture so it can't join the sprite batches. Labels always sit
+	// on top of their button so drawing them last keeps the same layering
+	for (const auto& node : _nodes) {
+		if (node.visible && node.button && node.button->getText())
+			target->draw(*node.button->getText());
+	}
+	_redraw = false;
+}
+
+AlphaSpans Scene::_composeMask() {
+	// Union the cached spans of each visible sprite at its position rather than drawing
+	// the sprites and reading the result back from the GPU. Sprites are only ever
+	// translated, so their position is all that is needed to place them
+	std::vector<AlphaSpansLayer> layers;
+	for (const auto& node : _nodes) {
+		if (!node.visible)
+			continue;
+		auto& spans = GraphicsManager::getSpans(node.texture, node.textureRect);
+		layers.push_back(AlphaSpansLayer{ &spans, (int)std::lround(node.position.x), (int)std::lround(node.position.y) });
+	}
+	return AlphaSpans::compose(_width, _height, layers);
+}
+
+const AlphaSpans& Scene::_getMask() {
+	_maskKey.clear();
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		const auto& node = _nodes[i];
+		if (!node.visible)
+			continue;
+		_maskKey.insert(_maskKey.end(), { (std::int64_t)i, (std::int64_t)(std::intptr_t)node.texture,
+			std::lround(node.position.x), std::lround(node.position.y),
+			node.textureRect.position.x, node.textureRect.position.y, node.textureRect.size.x, node.textureRect.size.y });
+	}
+	for (size_t i = 0; i < _masks.size(); i++) {
+		if (_masks[i].key != _maskKey)
+			continue;
+		std::rotate(_masks.begin(), _masks.begin() + i, _masks.begin() + i + 1);
+		return _masks.front().spans;
+	}
+	if (_masks.size() >= MASK_CACHE_SIZE)
+		_masks.pop_back();
+	_masks.insert(_masks.begin(), Mask{ _maskKey, _composeMask() });
+	return _masks.front().spans;
+}
+
+void Scene::_add(sf::Sprite* sprite, Button* button, bool visible) {
+	assert(sprite);
+	_nodes.push_back(Node{ sprite, button, visible, NULL, sf::Vector2f{}, sf::IntRect{} });
+	invalidate();
+}
+
+Scene::Node* Scene::_find(sf::Sprite* sprite) {
+	for (auto& node : _nodes) {
+		if (node.sprite == sprite)
+			return &node;
+	}
+	return NULL;
+}
+
+void Scene::_buildBatches() {
+	// Consecutive sprites sharing a texture go in the same batch, which keeps the draw
+	// order intact. With the atlas that is every sprite
+	_batches.clear();
+	for (const auto& node : _nodes) {
+		if (!node.visible)
+			continue;
+		if (_batches.empty() || _batches.back().texture != node.texture)
+			_batches.push_back(Batch{ node.texture, sf::VertexArray(sf::PrimitiveType::Triangles) });
+		auto& vertices = _batches.back().vertices;
+
+		const auto& transform = node.sprite->getTransform();
+		auto color = node.sprite->getColor();
+		sf::Vector2f size(node.textureRect.size);
+		sf::Vector2f uv(node.textureRect.position);
+		const sf::Vector2f corners[] = { { 0, 0 }, { size.x, 0 }, { 0, size.y }, { size.x, size.y } };
+		const int triangles[] = { 0, 1, 2, 2, 1, 3 };
+		for (int corner : triangles)
+			vertices.append(sf::Vertex{ transform.transformPoint(corners[corner]), color, uv + corners[corner] });
+	}
+}
+
+void Scene::_snapshot() {
+	// Sprites are owned by the caller and can be moved or re-cropped directly, so compare
+	// against what was last used rather than relying on every caller to report it
+	for (auto& node : _nodes) {
+		auto texture = &node.sprite->getTexture();
+		auto position = node.sprite->getPosition();
+		auto textureRect = node.sprite->getTextureRect();
+		if (texture == node.texture && position == node.position && textureRect == node.textureRect)
+			continue;
+		node.texture = texture;
+		node.position = position;
+		node.textureRect = textureRect;
+		// Hidden sprites are neither drawn nor part of the mask so moving them changes nothing
+		if (node.visible)
+			invalidate();
+	}
+}
@@ -0,0 +1,183 @@
+#include <SearchIndex.h>
+#include <algorithm>
+
+// Lists covering more than this share of the entries say little about a match, so fuzzy
+// matching does not bother counting through them
+static const size_t COMMON_DIVISOR = 8;
+// Most matches that get ranked. A query matching more than this is not narrowing things
+// down yet, and the earliest entries are as good as any
+static const size_t MAX_RANKED = 2048;
+
+// Lower case with anything that is not a letter or digit turned into a single space. Bytes
+// outside ASCII are kept so UTF-8 text still matches itself
+std::string SearchIndex::normalise(std::string_view text) {
+	std::string out;
+	out.reserve(text.size());
+	for (unsigned char c : text) {
+		bool keep = c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+		if (keep)
+			out += (c >= 'A' && c <= 'Z') ? (char)(c + 32) : (char)c;
+		else if (!out.empty() && out.back() != ' ')
+			out += ' ';
+	}
+	if (!out.empty() && out.back() == ' ')
+		out.pop_back();
+	return out;
+}
+
+// Trigrams within each word of normalised text, packed into integers
+void SearchIndex::_trigrams(std::string_view text, std::vector<uint32_t>& out) {
+	for (size_t i = 0; i + 3 <= text.size(); i++) {
+		if (text[i] == ' ' || text[i + 1] == ' ' || text[i + 2] == ' ')
+			continue;
+		out.push_back((uint8_t)text[i] << 16 | (uint8_t)text[i + 1] << 8 | (uint8_t)text[i + 2]);
+	}
+}
+
+uint32_t SearchIndex::add(std::string_view text) {
+	uint32_t id = _offsets.size();
+	auto normalised = normalise(text);
+	_offsets.push_back(_texts.size());
+	_texts.insert(_texts.end(), normalised.begin(), normalised.end());
+
+	std::vector<uint32_t> trigrams;
+	_trigrams(normalised, trigrams);
+	for (auto trigram : trigrams) {
+		// Ids only go up, so a repeated trigram is always at the back
+		auto& postings = _postings[trigram];
+		if (postings.empty() || postings.back() != id)
+			postings.push_back(id);
+	}
+	return id;
+}
+
+void SearchIndex::clear() {
+	_postings.clear();
+	_texts.clear();
+	_offsets.clear();
+}
+
+size_t SearchIndex::size() const {
+	return _offsets.size();
+}
+
+std::string_view SearchIndex::_text(uint32_t id) const {
+	size_t end = id + 1 < _offsets.size() ? _offsets[id + 1] : _texts.size();
+	return std::string_view(_texts.data() + _offsets[id], end - _offsets[id]);
+}
+
+// Shared trigrams count for most, then whole words found, then words found at the start
+// of a word, with shorter text breaking ties
+int SearchIndex::_score(uint32_t id, const std::vector<std::string>& words, int shared) const {
+	auto text = _text(id);
+	int score = shared * 16;
+	for (auto& word : words) {
+		auto found = text.find(word);
+		if (found == std::string_view::npos)
+			continue;
+		score += 64;
+		if (found == 0 || text[found - 1] == ' ')
+			score += 32;
+	}
+	return score * 256 - (int)std::min<size_t>(text.size(), 255);
+}
+
+std::vector<uint32_t> SearchIndex::search(std::string_view query, size_t maxResults) const {
+	std::vector<uint32_t> results;
+	auto normalised = normalise(query);
+	if (normalised.empty() || maxResults == 0)
+		return results;
+	std::vector<std::string> words;
+	for (size_t start = 0; start < normalised.size();) {
+		size_t end = normalised.find(' ', start);
+		if (end == std::string::npos)
+			end = normalised.size();
+		words.push_back(normalised.substr(start, end - start));
+		start = end + 1;
+	}
+
+	std::vector<uint32_t> trigrams;
+	_trigrams(normalised, trigrams);
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	std::vector<Candidate> candidates;
+	if (trigrams.empty()) {
+		// Too short for trigrams, so look through the text itself. This is only the first
+		// keystroke or two, and stops once it has plenty to rank
+		for (uint32_t id = 0; id < _offsets.size() && candidates.size() < maxResults * 16; id++) {
+			int score = _score(id, words, 0);
+			if (score >= 64 * 256 * (int)words.size() - 255)
+				candidates.push_back(Candidate{ id, score });
+		}
+	}
+	else {
+		std::vector<const std::vector<uint32_t>*> lists;
+		for (auto trigram : trigrams) {
+			auto found = _postings.find(trigram);
+			if (found != _postings.end())
+				lists.push_back(&found->second);
+		}
+		std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+		// Entries with every trigram, intersecting from the shortest list
+		std::vector<uint32_t> matches;
+		if (lists.size() == trigrams.size()) {
+			matches = *lists[0];
+			std::vector<uint32_t> next;
+			for (size_t i = 1; i < lists.size() && !matches.empty(); i++) {
+				next.clear();
+				std::set_intersection(matches.begin(), matches.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(next));
+				matches.swap(next);
+			}
+		}
+		if (matches.size() > MAX_RANKED)
+			matches.resize(MAX_RANKED);
+		for (auto id : matches)
+			candidates.push_back(Candidate{ id, _score(id, words, trigrams.size()) });
+
+		// Not enough, so fall back to entries sharing most of the trigrams to allow typos
+		if (candidates.size() < maxResults && trigrams.size() > 1) {
+			_counts.resize(_offsets.size());
+			_counted.clear();
+			size_t common = std::max<size_t>(_offsets.size() / COMMON_DIVISOR, 64);
+			int counted = 0;
+			for (auto list : lists) {
+				if (list->size() > common)
+					continue;
+				counted++;
+				for (auto id : *list) {
+					if (_counts[id] == 0)
+						_counted.push_back(id);
+					_counts[id] += _counts[id] < 255;
+				}
+			}
+			// Two thirds of the query's trigrams, of those that were counted. Only the lowest
+			// ids of those close enough are ranked, as they would be walking the whole index
+			int needed = std::max<int>(1, (counted * 2 + 2) / 3);
+			size_t close = 0;
+			for (auto id : _counted) {
+				if (_counts[id] >= needed && !std::binary_search(matches.begin(), matches.end(), id))
+					_counted[close++] = id;
+				else
+					_counts[id] = 0;
+			}
+			size_t ranked = std::min(close, MAX_RANKED * 2 - candidates.size());
+			std::nth_element(_counted.begin(), _counted.begin() + ranked, _counted.begin() + close);
+			for (size_t i = 0; i < close; i++) {
+				uint32_t id = _counted[i];
+				if (i < ranked)
+					candidates.push_back(Candidate{ id, _score(id, words, _counts[id]) });
+				_counts[id] = 0;
+			}
+		}
+	}
+
+	size_t count = std::min(maxResults, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.score != b.score ? a.score > b.score : a.id < b.id;
+	});
+	for (size_t i = 0; i < count; i++)
+		results.push_back(candidates[i].id);
+	return results;
+}
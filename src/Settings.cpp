@@ -17,8 +17,27 @@ toml::value Settings::_getValue(std::string key) {
 	return _toml.at(key);
 }
 
+bool Settings::has(std::string key) {
+	return _toml.contains(key);
+}
+
 bool Settings::getBool(std::string key) {
 	auto v = _getValue(key);
 	assert(v.is_boolean());
 	return v.as_boolean();
 }
+
+std::string Settings::getString(std::string key) {
+	auto v = _getValue(key);
+	assert(v.is_string());
+	return v.as_string();
+}
+
+float Settings::getFloat(std::string key) {
+	auto v = _getValue(key);
+	// Whole numbers are written without a decimal point
+	if (v.is_integer())
+		return v.as_integer();
+	assert(v.is_floating());
+	return v.as_floating();
+}
@@ -0,0 +1,129 @@
+#include <SpectrumAnalyzer.h>
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+static const float MIN_FREQUENCY = 50;
+static const float MAX_FREQUENCY = 16000;
+// Levels below this read as silence
+static const float FLOOR_DB = -60;
+// Boost per octave above 1kHz, and cut per octave below it
+static const float TILT_DB = 3;
+// How far a bar falls per second once the level under it drops
+static const float FALL_RATE = 1.5f;
+// Anything further behind than this once the elapsed time is taken is skipped, so clock
+// drift between the device and the UI can never build up a delay
+static const size_t MAX_BACKLOG_FRAMES = 8192;
+static const size_t BLOCK_SAMPLES = 4096;
+
+SpectrumAnalyzer::SpectrumAnalyzer(size_t bandCount, size_t size) : _fft(size) {
+	_history.resize(size);
+	_window.resize(size);
+	_windowed.resize(size);
+	_re.resize(size / 2 + 1);
+	_im.resize(size / 2 + 1);
+	_block.resize(BLOCK_SAMPLES);
+	_first.resize(bandCount);
+	_last.resize(bandCount);
+	_tilt.resize(bandCount);
+	_bands.resize(bandCount);
+
+	// Hann window. A full scale tone peaks at half its sum, which sets 0dB
+	float sum = 0;
+	for (size_t i = 0; i < size; i++) {
+		_window[i] = (float)(0.5 - 0.5 * std::cos(2 * PI * i / size));
+		sum += _window[i];
+	}
+	_scale = 1 / (sum * sum * 0.25f);
+}
+
+void SpectrumAnalyzer::update(PlaybackEngine& music, sf::Time elapsed) {
+	float fall = FALL_RATE * elapsed.asSeconds();
+	unsigned int channels = music.getChannelCount();
+	unsigned int sampleRate = music.getSampleRate();
+	size_t taken = 0;
+	if (channels > 0 && sampleRate > 0 && channels <= _block.size()) {
+		if (sampleRate != _sampleRate)
+			_setBands(sampleRate);
+		// Take what played over the elapsed time. Once the tap runs dry nothing more is
+		// owed, otherwise the next chunk would be rushed through all at once
+		size_t available = music.getTapSize() / channels;
+		_due += elapsed.asSeconds() * sampleRate;
+		size_t frames = std::min((size_t)_due, available);
+		if (available - frames > MAX_BACKLOG_FRAMES)
+			frames = available - MAX_BACKLOG_FRAMES;
+		_due = frames >= available ? std::min(_due - frames, 1.0) : std::max(_due - frames, 0.0);
+		while (taken < frames) {
+			size_t count = std::min(frames - taken, _block.size() / channels);
+			count = music.readTap(_block.data(), count * channels) / channels;
+			if (count == 0)
+				break;
+			_take(_block.data(), count, channels);
+			taken += count;
+		}
+	}
+
+	if (taken > 0) {
+		_analyze(fall);
+	}
+	else {
+		for (auto& band : _bands)
+			band = std::max(band - fall, 0.0f);
+	}
+	_active = taken > 0 || std::any_of(_bands.begin(), _bands.end(), [](float band) { return band > 0; });
+}
+
+const std::vector<float>& SpectrumAnalyzer::getBands() const {
+	return _bands;
+}
+
+bool SpectrumAnalyzer::isActive() const {
+	return _active;
+}
+
+void SpectrumAnalyzer::_take(const std::int16_t* samples, size_t frames, unsigned int channels) {
+	const float scale = 1.0f / (32768.0f * channels);
+	const size_t mask = _history.size() - 1;
+	for (size_t i = 0; i < frames; i++) {
+		int sum = 0;
+		for (unsigned int channel = 0; channel < channels; channel++)
+			sum += samples[i * channels + channel];
+		_history[_position] = sum * scale;
+		_position = (_position + 1) & mask;
+	}
+}
+
+void SpectrumAnalyzer::_setBands(unsigned int sampleRate) {
+	_sampleRate = sampleRate;
+	size_t size = _fft.getSize();
+	float top = std::min(MAX_FREQUENCY, sampleRate * 0.5f);
+	float ratio = std::pow(top / MIN_FREQUENCY, 1.0f / _bands.size());
+	for (size_t band = 0; band < _bands.size(); band++) {
+		float low = MIN_FREQUENCY * std::pow(ratio, (float)band);
+		float high = low * ratio;
+		// The lowest bands are narrower than a bin, so each gets at least one to itself
+		_first[band] = std::min((size_t)std::lround(low * size / sampleRate), size / 2);
+		_last[band] = std::min(std::max((size_t)std::lround(high * size / sampleRate), _first[band] + 1), size / 2 + 1);
+		_tilt[band] = TILT_DB * std::log2(std::sqrt(low * high) / 1000);
+	}
+}
+
+void SpectrumAnalyzer::_analyze(float fall) {
+	// Oldest sample first, starting from where the next one would be written
+	size_t size = _history.size();
+	size_t tail = size - _position;
+	for (size_t i = 0; i < tail; i++)
+		_windowed[i] = _history[_position + i] * _window[i];
+	for (size_t i = 0; i < _position; i++)
+		_windowed[tail + i] = _history[i] * _window[tail + i];
+	_fft.forward(_windowed.data(), _re.data(), _im.data());
+
+	for (size_t band = 0; band < _bands.size(); band++) {
+		float power = 0;
+		for (size_t bin = _first[band]; bin < _last[band]; bin++)
+			power += _re[bin] * _re[bin] + _im[bin] * _im[bin];
+		float level = 10 * std::log10(power * _scale + 1e-12f) + _tilt[band];
+		level = std::clamp((level - FLOOR_DB) / -FLOOR_DB, 0.0f, 1.0f);
+		_bands[band] = std::max(level, _bands[band] - fall);
+	}
+}
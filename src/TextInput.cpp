@@ -0,0 +1,86 @@
+#include <TextInput.h>
+
+TextInput::TextInput(std::string path, float x, float y, sf::Font* font, int width, int height) {
+	_button = new Button(path, x, y, width, height);
+	_button->setText("", font);
+	_button->getText()->setCharacterSize(16);
+	_button->setTextOffset(6, 6);
+}
+
+TextInput::~TextInput() {
+	delete _button;
+}
+
+static void appendUtf8(std::string& out, char32_t c) {
+	if (c < 0x80) {
+		out += (char)c;
+	}
+	else if (c < 0x800) {
+		out += (char)(0xC0 | (c >> 6));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+	else if (c < 0x10000) {
+		out += (char)(0xE0 | (c >> 12));
+		out += (char)(0x80 | ((c >> 6) & 0x3F));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+	else {
+		out += (char)(0xF0 | (c >> 18));
+		out += (char)(0x80 | ((c >> 12) & 0x3F));
+		out += (char)(0x80 | ((c >> 6) & 0x3F));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+}
+
+bool TextInput::handleEvent(const sf::Event& event) {
+	auto textEntered = event.getIf<sf::Event::TextEntered>();
+	if (!textEntered)
+		return false;
+	char32_t c = textEntered->unicode;
+	if (c == '\b') {
+		if (_string.empty())
+			return false;
+		// Remove the whole of the last UTF-8 character
+		size_t end = _string.size() - 1;
+		while (end > 0 && (_string[end] & 0xC0) == 0x80)
+			end--;
+		_string.resize(end);
+	}
+	// Ignore the rest of the control characters, like enter and escape
+	else if (c >= 0x20 && c != 0x7F) {
+		appendUtf8(_string, c);
+	}
+	else {
+		return false;
+	}
+	_update();
+	return true;
+}
+
+const std::string& TextInput::getString() {
+	return _string;
+}
+
+void TextInput::clear() {
+	_string.clear();
+	_update();
+}
+
+Button* TextInput::getButton() {
+	return _button;
+}
+
+void TextInput::_update() {
+	auto text = _button->getText();
+	float width = _button->getSprite()->getGlobalBounds().size.x - 12;
+	// Drop characters from the front until the end of the text fits
+	size_t start = 0;
+	while (true) {
+		text->setString(sf::String::fromUtf8(_string.begin() + start, _string.end()));
+		if (start == _string.size() || text->getGlobalBounds().size.x <= width)
+			break;
+		start++;
+		while (start < _string.size() && (_string[start] & 0xC0) == 0x80)
+			start++;
+	}
+}
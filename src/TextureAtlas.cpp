@@ -0,0 +1,161 @@
+#include <TextureAtlas.h>
+#include <OSInterface.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include "../lib/toml.hpp"
+
+// Bump whenever the layout of the cached index changes
+static const int ATLAS_VERSION = 1;
+// Gap between images so neighbouring art never bleeds into a sprite
+static const unsigned int ATLAS_PADDING = 1;
+
+// Modification time and size of an asset, used to detect a stale atlas
+static std::pair<std::int64_t, std::int64_t> fileStamp(const std::string& path) {
+	std::error_code error;
+	auto modified = std::filesystem::last_write_time(path, error);
+	if (error)
+		return { -1, -1 };
+	auto size = std::filesystem::file_size(path, error);
+	if (error)
+		return { -1, -1 };
+	return { (std::int64_t)modified.time_since_epoch().count(), (std::int64_t)size };
+}
+
+bool TextureAtlas::load(const std::vector<std::string>& names) {
+	_rects.clear();
+	if (_loadCached(names))
+		return true;
+	_rects.clear();
+	if (!_build(names))
+		return false;
+	_save(names);
+	return true;
+}
+
+bool TextureAtlas::contains(const std::string& name) const {
+	return _rects.count(name) > 0;
+}
+
+sf::IntRect TextureAtlas::getRect(const std::string& name) const {
+	assert(contains(name));
+	return _rects.at(name);
+}
+
+const sf::Image& TextureAtlas::getImage() const {
+	return _image;
+}
+
+std::string TextureAtlas::getPath() const {
+	return OSInterface::getConfigPath() + "/atlas.png";
+}
+
+// Shelf packing: the tallest images go first and fill rows left to right, starting a new
+// row when one is full. The width is the smallest power of two that keeps the atlas
+// roughly square
+sf::Vector2u TextureAtlas::pack(const std::vector<sf::Vector2u>& sizes, std::vector<sf::IntRect>& rects) {
+	unsigned long area = 0;
+	unsigned int widest = 0;
+	for (auto size : sizes) {
+		area += (unsigned long)(size.x + ATLAS_PADDING) * (size.y + ATLAS_PADDING);
+		widest = std::max(widest, size.x + ATLAS_PADDING);
+	}
+	unsigned int width = 1;
+	while (width < widest || (unsigned long)width * width < area)
+		width *= 2;
+
+	std::vector<size_t> order(sizes.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a].y > sizes[b].y; });
+
+	rects.assign(sizes.size(), sf::IntRect{});
+	unsigned int x = 0;
+	unsigned int y = 0;
+	unsigned int shelfHeight = 0;
+	for (auto i : order) {
+		if (x + sizes[i].x > width) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		rects[i] = sf::IntRect(sf::Vector2i(x, y), sf::Vector2i(sizes[i]));
+		x += sizes[i].x + ATLAS_PADDING;
+		shelfHeight = std::max(shelfHeight, sizes[i].y + ATLAS_PADDING);
+	}
+	return sf::Vector2u{width, y + shelfHeight};
+}
+
+bool TextureAtlas::_loadCached(const std::vector<std::string>& names) {
+	if (!std::filesystem::exists(_indexPath()) || !std::filesystem::exists(getPath()))
+		return false;
+	try {
+		auto index = toml::parse(_indexPath());
+		if (index.at("version").as_integer() != ATLAS_VERSION)
+			return false;
+		auto& images = index.at("images").as_table();
+		if (images.size() != names.size())
+			return false;
+		for (const auto& name : names) {
+			auto& entry = images.at(name);
+			auto stamp = fileStamp(OSInterface::asset(name));
+			if (entry.at("modified").as_integer() != stamp.first || entry.at("size").as_integer() != stamp.second)
+				return false;
+			_rects[name] = sf::IntRect(
+				sf::Vector2i(entry.at("x").as_integer(), entry.at("y").as_integer()),
+				sf::Vector2i(entry.at("width").as_integer(), entry.at("height").as_integer()));
+		}
+	}
+	catch (const std::exception&) {
+		// A missing or broken index just means building the atlas again
+		return false;
+	}
+	return _image.loadFromFile(getPath());
+}
+
+bool TextureAtlas::_build(const std::vector<std::string>& names) {
+	std::vector<sf::Image> images(names.size());
+	std::vector<sf::Vector2u> sizes;
+	for (size_t i = 0; i < names.size(); i++) {
+		if (!images[i].loadFromFile(OSInterface::asset(names[i])))
+			return false;
+		sizes.push_back(images[i].getSize());
+	}
+	std::vector<sf::IntRect> rects;
+	_image = sf::Image(pack(sizes, rects), sf::Color::Transparent);
+	for (size_t i = 0; i < names.size(); i++) {
+		if (!_image.copy(images[i], sf::Vector2u(rects[i].position)))
+			return false;
+		_rects[names[i]] = rects[i];
+	}
+	return true;
+}
+
+void TextureAtlas::_save(const std::vector<std::string>& names) {
+	// Failing to cache the atlas only costs rebuilding it on the next launch
+	if (!_image.saveToFile(getPath())) {
+		printf("Could not save texture atlas to %s\n", getPath().c_str());
+		return;
+	}
+	toml::value index(toml::table{});
+	index["version"] = ATLAS_VERSION;
+	index["images"] = toml::table{};
+	for (const auto& name : names) {
+		auto rect = _rects[name];
+		auto stamp = fileStamp(OSInterface::asset(name));
+		index["images"][name] = toml::table{
+			{ "x", rect.position.x },
+			{ "y", rect.position.y },
+			{ "width", rect.size.x },
+			{ "height", rect.size.y },
+			{ "modified", stamp.first },
+			{ "size", stamp.second },
+		};
+	}
+	std::ofstream(_indexPath()) << toml::format(index);
+}
+
+std::string TextureAtlas::_indexPath() const {
+	return OSInterface::getConfigPath() + "/atlas.toml";
+}
@@ -0,0 +1,57 @@
+#include <ThreadPool.h>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads, std::function<void()> onStart) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < threads; i++)
+		_threads.emplace_back(&ThreadPool::_work, this, onStart);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_jobReady.notify_all();
+	for (auto& thread : _threads)
+		thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_jobReady.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _jobs.empty() && _busy == 0; });
+}
+
+unsigned int ThreadPool::getThreadCount() const {
+	return _threads.size();
+}
+
+void ThreadPool::_work(std::function<void()> onStart) {
+	if (onStart)
+		onStart();
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_jobReady.wait(lock, [this] { return _stop || !_jobs.empty(); });
+		// Queued jobs are dropped on shutdown
+		if (_stop)
+			return;
+		auto job = std::move(_jobs.front());
+		_jobs.pop_front();
+		_busy++;
+		lock.unlock();
+		job();
+		lock.lock();
+		_busy--;
+		if (_jobs.empty() && _busy == 0)
+			_idle.notify_all();
+	}
+}
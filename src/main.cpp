@@ -1,5 +1,4 @@
 #include <SFML/Graphics.hpp>
-#include <SFML/Audio/Music.hpp>
 #include <stdio.h>
 #include <vector>
 #include <future>
@@ -8,14 +7,37 @@
 #include <OSInterface.h>
 #include <Button.h>
 #include <Settings.h>
+#include <Scene.h>
+#include <PlaybackEngine.h>
+#include <AmbientMixer.h>
+#include <ProceduralSource.h>
+#include <Playlist.h>
+#include <LibraryScanner.h>
+#include <SearchIndex.h>
+#include <TextInput.h>
+#include <PlayOrder.h>
+#include <LoudnessScanner.h>
+#include <SpectrumAnalyzer.h>
+#include <BeatTracker.h>
+#include <Animation.h>
+#include <filesystem>
 
-int main() {
+int main(int argc, char** argv) {
 	auto settings = new Settings();
 	bool desktopBuddy = settings->getBool("desktop-buddy");
+	// Older config files will not have this yet, and only changes are sent by default
+	auto shapeMode = settings->has("shape-mode") ? settings->getString("shape-mode") : "";
+	if (shapeMode == "pixmap")
+		OSInterface::setShapeMode(OSInterface::ShapeMode::Pixmap);
+	else if (shapeMode == "rectangles")
+		OSInterface::setShapeMode(OSInterface::ShapeMode::Rectangles);
+	bool benchShape = argc > 1 && std::string(argv[1]) == "--bench-shape";
 	// Menu buttons
 	const unsigned int BTN_PLAYLIST = 0;
-	const unsigned int BTN_SETTINGS = 1;
-	const unsigned int BTN_QUIT = 2;
+	const unsigned int BTN_FOLDER = 1;
+	const unsigned int BTN_SEARCH = 2;
+	const unsigned int BTN_SETTINGS = 3;
+	const unsigned int BTN_QUIT = 4;
 
 	// Dimensions
 	const unsigned int deskHeight = 146;
@@ -25,13 +47,18 @@ int main() {
 	const unsigned int headVMargin = 10;
 	const unsigned int menuButtonHeight = 32;
 	const unsigned int menuButtonWidth = 128;
-	const unsigned int menuButtonCount = 3;
+	const unsigned int menuButtonCount = 5;
 	const unsigned int menuButtonVMargin = 10;
 	const unsigned int menuPadding = 5;
 	const unsigned int winVMargin = 50;
 	const unsigned int winHMargin = 50;
 	const unsigned int settingsWidth = 400;
 	const unsigned int settingsHeight = 400;
+	const unsigned int barWidth = 4;
+	const unsigned int barGap = 2;
+	const unsigned int barHeight = 24;
+	const unsigned int barMargin = 12;
+	const float nodDepth = 2;
 	unsigned int menuHeight = ((menuButtonHeight + menuButtonVMargin) * menuButtonCount) + (menuPadding * 2) - menuButtonVMargin;
 	unsigned int menuWidth = menuButtonWidth + (menuPadding * 2);
 	unsigned int winWidth = deskWidth;
@@ -47,6 +74,13 @@ int main() {
 	auto window = new sf::RenderWindow(sf::VideoMode({winWidth, winHeight}), "Lofi Buddy", windowStyle);
 	window->setPosition(sf::Vector2i(winX, winY));
 	window->setFramerateLimit(30);
+	const sf::Time frameTime = sf::milliseconds(1000 / 30);
+	// How long to sleep for when nothing is happening. This is the longest it takes to
+	// notice the current track has ended
+	const sf::Time idleTime = sf::milliseconds(100);
+
+	// Pack all of the UI art into one texture so the scene draws from a single texture
+	GraphicsManager::loadAtlas({ "head.png", "menu.png", "menu-button.png", "test.jpg" });
 
 	// Font init
 	auto font = new sf::Font();
@@ -56,7 +90,13 @@ int main() {
 	// Main Textures and Buttons
 	float headX = winWidth - headWidth;
 	float headY = winHeight - headHeight - deskHeight - headVMargin;
-	auto headButton = new Button("head.png", headX, headY);
+	auto headButton = new Button("head.png", headX, headY, headWidth, headHeight);
+	// The head image is a strip of idle frames, the first being the still pose
+	auto headRect = GraphicsManager::getRect("head.png");
+	std::vector<sf::Time> headFrames(std::max(headRect.size.x / (int)headWidth, 1), sf::milliseconds(150));
+	Animation headIdle(headButton->getSprite(), headRect, sf::Vector2i{ (int)headWidth, (int)headHeight }, headFrames);
+	headIdle.play();
+	sf::Clock animationClock;
 
 	float deskX = winWidth - deskWidth;
 	float deskY = winHeight - deskHeight;
@@ -80,6 +120,12 @@ int main() {
 			case BTN_PLAYLIST:
 				t = "Playlist";
 				break;
+			case BTN_FOLDER:
+				t = "Add Folder";
+				break;
+			case BTN_SEARCH:
+				t = "Search";
+				break;
 			case BTN_SETTINGS:
 				t = "Settings";
 				break;
@@ -113,55 +159,284 @@ int main() {
 	std::vector<Button*> buttons;
 	buttons.push_back(headButton);
 
-	// Initialise default music track
-	std::vector<std::string> tracks = { OSInterface::asset("test.mp3") };
-	unsigned int trackIndex = 0;
-	sf::Music music;
-	if (!music.openFromFile(tracks[trackIndex]))
+	// Everything drawn in the main window, in drawing order. This also makes up the window shape
+	auto scene = new Scene(winWidth, winHeight);
+	for (auto s : sprites)
+		scene->add(s);
+	for (auto b : buttons)
+		scene->add(b);
+	scene->add(menuSprite, false);
+	for (auto b : menuButtons)
+		scene->add(b, false);
+
+	// Search window sprites, the text field and a line per result
+	const unsigned int searchResultCount = 12;
+	const unsigned int searchLineHeight = 24;
+	auto searchBackgroundSprite = GraphicsManager::createSprite("menu.png", 0, 0);
+	assert(searchBackgroundSprite);
+	auto searchInput = new TextInput("menu-button.png", menuPadding * 2, menuPadding * 2, font);
+	std::vector<sf::Text*> searchResultTexts;
+	for (unsigned int i = 0; i < searchResultCount; i++) {
+		auto text = new sf::Text(*font);
+		text->setCharacterSize(16);
+		text->setFillColor(sf::Color::Black);
+		text->setPosition(sf::Vector2f{ (float)menuPadding * 2, (float)(menuPadding * 2 + menuButtonHeight + menuButtonVMargin + i * searchLineHeight) });
+		searchResultTexts.push_back(text);
+	}
+
+	auto settingsScene = new Scene(settingsWidth, settingsHeight);
+	settingsScene->add(settingsBackgroundSprite);
+	if (desktopBuddy)
+		settingsScene->add(settingsCloseButton);
+	settingsScene->add(settingsSaveButton);
+
+	auto searchScene = new Scene(settingsWidth, settingsHeight);
+	searchScene->add(searchBackgroundSprite);
+	searchScene->add(searchInput->getButton());
+
+	// Compare the ways of setting the window shape with the menu open and exit
+	if (benchShape) {
+		scene->setVisible(menuSprite, true);
+		for (auto b : menuButtons)
+			scene->setVisible(b, true);
+		scene->benchmarkShape(window, 100);
+		OSInterface::cleanupWindow(window);
+		return 0;
+	}
+
+	// Pick up the last selection from the playlists directory, or the default music track
+	Playlist tracks;
+	auto currentPlaylist = Playlist::getDirectory() + "/current.m3u8";
+	if (!std::filesystem::exists(currentPlaylist) || !tracks.load(currentPlaylist) || tracks.empty())
+		tracks.add(OSInterface::asset("test.mp3"));
+	// Shuffle and repeat come from the config, going round the playlist in order by default
+	PlayOrder order;
+	if (settings->has("shuffle"))
+		order.setShuffle(settings->getBool("shuffle"));
+	if (settings->has("repeat")) {
+		auto repeat = settings->getString("repeat");
+		order.setRepeat(repeat == "off" ? PlayOrder::Repeat::Off : repeat == "one" ? PlayOrder::Repeat::One : PlayOrder::Repeat::All);
+	}
+	order.reset(tracks.size());
+	// Set once the last track has finished with repeat off, until something else is played
+	bool playlistEnded = false;
+	// Track details from earlier scans, looked up in place without parsing anything
+	MetadataCache library;
+	library.load();
+	// Loudness and beats are measured in the background, starting from the current track.
+	// Once known the loudness evens out the volume between tracks and the head nods along
+	const float loudnessTarget = -18;
+	bool normaliseLoudness = !settings->has("normalise-loudness") || settings->getBool("normalise-loudness");
+	bool beatTracking = !settings->has("beat-tracking") || settings->getBool("beat-tracking");
+	LoudnessScanner loudness(library);
+	auto analyseTracks = [&](size_t from) {
+		if (!normaliseLoudness && !beatTracking)
+			return;
+		size_t start = from == 0 ? order.current() : 0;
+		for (size_t i = from; i < tracks.size(); i++)
+			loudness.add(tracks.getPath(from == 0 ? (start + i) % tracks.size() : i));
+	};
+	auto trackGain = [&](size_t index) {
+		return normaliseLoudness ? loudness.getGain(tracks.getPath(index), loudnessTarget) : 1.0f;
+	};
+	float beatTempo = 0;
+	float beatOffset = 0;
+	auto findBeat = [&]() {
+		if (!beatTracking || !loudness.getBeat(tracks.getPath(order.current()), beatTempo, beatOffset))
+			beatTempo = 0;
+	};
+	auto showNowPlaying = [&]() {
+		TrackInfo info;
+		std::string title(tracks.getTitle(order.current()));
+		if (library.find(tracks.getPath(order.current()), info))
+			title = info.artist.empty() ? info.title : info.artist + " - " + info.title;
+		if (title.empty())
+			title = std::filesystem::path(tracks.getPath(order.current())).stem().string();
+		window->setTitle("Lofi Buddy - " + title);
+	};
+	// Titles and paths of the playlist for the search window, numbered by track index
+	SearchIndex searchIndex;
+	auto indexTracks = [&](size_t from) {
+		if (from == 0)
+			searchIndex.clear();
+		for (size_t i = from; i < tracks.size(); i++)
+			searchIndex.add(std::string(tracks.getTitle(i)) + " " + tracks.getPath(i));
+	};
+	indexTracks(0);
+	PlaybackEngine music;
+	// Queue whatever plays next so the engine can go straight into it
+	auto queueNext = [&]() {
+		size_t next = order.peekNext();
+		if (next == PlayOrder::NONE)
+			music.queue("");
+		else
+			music.queue(tracks.getPath(next), trackGain(next));
+	};
+	// Opens the current track of the play order
+	auto playCurrent = [&]() {
+		auto track = tracks.getPath(order.current());
+		if (!music.open(track, trackGain(order.current())))
+			pfd::message("Error", "Error playing track: " + track).result();
+		queueNext();
+		music.play();
+		showNowPlaying();
+		findBeat();
+		playlistEnded = false;
+	};
+	if (!music.open(tracks.getPath(order.current()), trackGain(order.current())))
 		return -1;
+	queueNext();
+	analyseTracks(0);
+	showNowPlaying();
+	findBeat();
 	music.play();
 	music.pause();
 
+	// Bars along the desk that follow the music. They sit inside the desk so the window
+	// shape never changes for them, and only need redrawing while they move
+	bool visualizer = settings->has("visualizer") && settings->getBool("visualizer");
+	music.setTapEnabled(visualizer);
+	SpectrumAnalyzer spectrum;
+	sf::VertexArray bars(sf::PrimitiveType::Triangles, spectrum.getBands().size() * 6);
+	sf::Clock visualizerClock;
+
+	// Ambient layers mixed under the music. A loop in the assets overrides the generated sound
+	AmbientMixer ambient;
+	std::pair<std::string, ProceduralSource::Kind> layers[] = {
+		{ "fireplace", ProceduralSource::Kind::Fireplace },
+		{ "wind", ProceduralSource::Kind::Wind },
+		{ "rain", ProceduralSource::Kind::Rain },
+		{ "snow", ProceduralSource::Kind::Snow },
+	};
+	for (auto& [name, kind] : layers) {
+		auto path = OSInterface::asset(name + ".ogg");
+		std::unique_ptr<AmbientSource> source;
+		auto file = std::make_unique<AmbientFileSource>();
+		if (std::filesystem::exists(path) && file->open(path, ambient.getMixSampleRate()))
+			source = std::move(file);
+		else
+			source = std::make_unique<ProceduralSource>(kind, ambient.getMixSampleRate());
+		float gain = settings->has("ambient-" + name) ? settings->getFloat("ambient-" + name) : 0;
+		ambient.addLayer(std::move(source), gain);
+	}
+	if (ambient.isAudible())
+		ambient.play();
+
 	// Global UI state
 	std::future<std::vector<std::string>> openFileFuture;
 	bool openFileOpen = false;
+	std::future<std::string> openFolderFuture;
+	bool openFolderOpen = false;
+	// Scanning runs in the background and does not block the menu
+	std::future<std::vector<TrackInfo>> scanFuture;
+	bool scanning = false;
 	bool menuOpen = false;
 	sf::RenderWindow* settingsWindow = NULL;
+	sf::RenderWindow* searchWindow = NULL;
+	std::vector<uint32_t> searchMatches;
 
 	// Main loop
     while (window->isOpen()) {
 		if (settingsWindow && settingsWindow->isOpen()) {
 			// check all the window's events that were triggered since the last iteration of the loop
 			while (auto event = settingsWindow->pollEvent()) {
+				if (!event->is<sf::Event::MouseMoved>())
+					settingsScene->requestRedraw();
 				if (event->is<sf::Event::Closed>()) {
-					settingsWindow->close();
+					// Clean up before closing, the native handle is gone afterwards
 					OSInterface::cleanupWindow(settingsWindow);
+					settingsWindow->close();
 					break;
 				}
 				if (auto mousePressed = event->getIf<sf::Event::MouseButtonPressed>()) {
-					if (desktopBuddy || settingsCloseButton->pressed(mousePressed, settingsWindow))
-						settingsWindow->close();
-					if (settingsSaveButton->pressed(mousePressed, settingsWindow))
+					if (desktopBuddy || settingsCloseButton->pressed(mousePressed, settingsWindow) || settingsSaveButton->pressed(mousePressed, settingsWindow)) {
+						OSInterface::cleanupWindow(settingsWindow);
 						settingsWindow->close();
+						break;
+					}
+				}
+			}
+			if (desktopBuddy && OSInterface::keepWindowOnTop(settingsWindow))
+				settingsScene->requestRedraw();
+			if (settingsWindow->isOpen() && settingsScene->needsRedraw()) {
+				settingsScene->draw(settingsWindow);
+				settingsWindow->display();
+			}
+		}
+
+		if (searchWindow && searchWindow->isOpen()) {
+			while (auto event = searchWindow->pollEvent()) {
+				if (!event->is<sf::Event::MouseMoved>())
+					searchScene->requestRedraw();
+				auto keyPressed = event->getIf<sf::Event::KeyPressed>();
+				if (event->is<sf::Event::Closed>() || (keyPressed && keyPressed->code == sf::Keyboard::Key::Escape)) {
+					OSInterface::cleanupWindow(searchWindow);
+					searchWindow->close();
+					break;
+				}
+				// Search again on every keystroke
+				if (searchInput->handleEvent(*event)) {
+					searchMatches = searchIndex.search(searchInput->getString(), searchResultCount);
+					for (size_t i = 0; i < searchMatches.size(); i++) {
+						std::string title(tracks.getTitle(searchMatches[i]));
+						if (title.empty())
+							title = std::filesystem::path(tracks.getPath(searchMatches[i])).stem().string();
+						searchResultTexts[i]->setString(sf::String::fromUtf8(title.begin(), title.end()));
+					}
+				}
+				// Clicking a result plays it
+				auto mousePressed = event->getIf<sf::Event::MouseButtonPressed>();
+				if (mousePressed && mousePressed->button == sf::Mouse::Button::Left) {
+					auto position = sf::Vector2f{ (float)mousePressed->position.x, (float)mousePressed->position.y };
+					for (size_t i = 0; i < searchMatches.size(); i++) {
+						if (!searchResultTexts[i]->getGlobalBounds().contains(position))
+							continue;
+						order.jump(searchMatches[i]);
+						playCurrent();
+						break;
+					}
 				}
 			}
-			if (desktopBuddy)
-				OSInterface::bringWindowToTop(settingsWindow); // TODO: Only do this if I need to to improve performance
-			settingsWindow->draw(*settingsBackgroundSprite);
-			if (desktopBuddy)
-				settingsCloseButton->draw(settingsWindow);
-			settingsSaveButton->draw(settingsWindow);
-			settingsWindow->display();
+			if (desktopBuddy && OSInterface::keepWindowOnTop(searchWindow))
+				searchScene->requestRedraw();
+			if (searchWindow->isOpen() && searchScene->needsRedraw()) {
+				searchScene->draw(searchWindow);
+				for (size_t i = 0; i < searchMatches.size(); i++)
+					searchWindow->draw(*searchResultTexts[i]);
+				searchWindow->display();
+			}
 		}
-        while (auto event = window->pollEvent()) {
-			bool settingsOpen = settingsWindow && settingsWindow->isOpen();
+
+		// Block until something happens rather than redrawing a static scene. Only poll at
+		// the frame rate while the settings window or file dialog need checking on, since
+		// neither wakes up this window
+		bool settingsOpen = (settingsWindow && settingsWindow->isOpen()) || (searchWindow && searchWindow->isOpen());
+		bool visualizerActive = visualizer && (music.getStatus() == sf::SoundSource::Status::Playing || spectrum.isActive());
+		bool nodding = beatTempo > 0 && music.getStatus() == sf::SoundSource::Status::Playing;
+		sf::Time timeout = (settingsOpen || openFileOpen || openFolderOpen || scanning || visualizerActive) ? frameTime : idleTime;
+		// Wake up for the next frame of the head, which follows the beat while nodding. A zero
+		// timeout would wait forever
+		if (nodding) {
+			float phase = BeatTracker::getPhase(beatTempo, beatOffset, music.getTrackOffset().asSeconds());
+			float next = headIdle.getFrameCount() > 1 ? headIdle.getNextFrameProgress() : phase < 0.25f ? 0.25f : 1.0f;
+			timeout = std::max(std::min(timeout, sf::seconds((next - phase) * 60 / beatTempo)), sf::milliseconds(1));
+		}
+		else if (headIdle.isPlaying()) {
+			timeout = std::max(std::min(timeout, headIdle.getTimeToNextFrame()), sf::milliseconds(1));
+		}
+		for (auto event = window->waitEvent(timeout); event; event = window->pollEvent()) {
+			settingsOpen = (settingsWindow && settingsWindow->isOpen()) || (searchWindow && searchWindow->isOpen());
+			// SFML has no expose event, so repaint after anything that may have uncovered
+			// the window. Hovering alone changes nothing
+			if (!event->is<sf::Event::MouseMoved>())
+				scene->requestRedraw();
 			if (event->is<sf::Event::Closed>()) {
-				window->close();
 				OSInterface::cleanupWindow(window);
+				window->close();
 				break;
 			}
 			// Emulate a modal dialog where we cannot interact with the main program
-			if (openFileOpen || settingsOpen)
+			if (openFileOpen || openFolderOpen || settingsOpen)
 				continue;
 			if (auto mousePressed = event->getIf<sf::Event::MouseButtonPressed>()) {
 				if (headButton->pressed(mousePressed, window)) {
@@ -183,19 +458,40 @@ int main() {
 							case BTN_PLAYLIST:
 								// TODO: File filter for audio files
 								if (!openFileOpen) {
-									openFileFuture = std::async(std::launch::async, [] () { return pfd::open_file("Select music", ".", { "All Files" , "*" }, pfd::opt::multiselect).result();});
+									openFileFuture = std::async(std::launch::async, [] () { return pfd::open_file("Select music", ".", { "All Files" , "*", "Playlists", "*.m3u *.m3u8" }, pfd::opt::multiselect).result();});
 									openFileOpen = true;
 									menuOpen = false;
 								}
 								break;
+							case BTN_FOLDER:
+								if (!openFolderOpen && !scanning) {
+									openFolderFuture = std::async(std::launch::async, [] () { return pfd::select_folder("Add music folder", ".").result(); });
+									openFolderOpen = true;
+									menuOpen = false;
+								}
+								break;
+							case BTN_SEARCH:
+								if (!searchWindow || !searchWindow->isOpen()) {
+									searchWindow = new sf::RenderWindow(sf::VideoMode({settingsWidth, settingsHeight}), "Lofi Buddy Search", windowStyle);
+									searchWindow->setPosition(sf::Vector2i{settingsX, settingsY});
+									searchScene->requestRedraw();
+									menuOpen = false;
+								}
+								break;
 							case BTN_SETTINGS:
 								if (!settingsWindow || !settingsWindow->isOpen()) {
 									settingsWindow = new sf::RenderWindow(sf::VideoMode({settingsWidth, settingsHeight}), "Lofi Buddy Settings", windowStyle);
 									settingsWindow->setPosition(sf::Vector2i{settingsX, settingsY});
+									settingsScene->requestRedraw();
 									menuOpen = false;
 								}
 								break;
 							case BTN_QUIT:
+								if (settingsWindow && settingsWindow->isOpen())
+									OSInterface::cleanupWindow(settingsWindow);
+								if (searchWindow && searchWindow->isOpen())
+									OSInterface::cleanupWindow(searchWindow);
+								OSInterface::cleanupWindow(window);
 								window->close();
 								break;
 						}
@@ -208,56 +504,132 @@ int main() {
 		if (openFileOpen && openFileFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
 			auto f = openFileFuture.get();
 			if (f.size() > 0) {
-				tracks = f;
-				trackIndex = 0;
-				auto track = tracks[trackIndex];
-				if (!music.openFromFile(track))
-					pfd::message("Error", "Error playing track: " + track).result();
-				music.play();
+				// Playlist files are imported into the playlists directory and their tracks queued
+				tracks.clear();
+				for (auto& path : f) {
+					if (!Playlist::isPlaylistFile(path)) {
+						tracks.add(path);
+						continue;
+					}
+					Playlist playlist;
+					auto imported = Playlist::import(path);
+					if (imported.empty() || !playlist.load(imported)) {
+						pfd::message("Error", "Error importing playlist: " + path).result();
+						continue;
+					}
+					for (size_t i = 0; i < playlist.size(); i++)
+						tracks.add(playlist.getPath(i), playlist.getTitle(i), playlist.getDuration(i));
+				}
+				if (tracks.empty())
+					tracks.add(OSInterface::asset("test.mp3"));
+				tracks.save(currentPlaylist);
+				indexTracks(0);
+				searchMatches.clear();
+				order.reset(tracks.size());
+				playCurrent();
+				analyseTracks(0);
 			}
 			openFileOpen = false;
 		}
 		
-		// Automatically advance to the next track when it gets to the end
-		if (music.getStatus() == sf::SoundSource::Status::Stopped) {
-			trackIndex++;
-			if (trackIndex >= tracks.size()) //Playlist loop by default for now
-				trackIndex = 0;
-			auto track = tracks[trackIndex];
-			if (!music.openFromFile(track))
-				pfd::message("Error", "Error playing track: " + track).result();
-			music.play();
+		// Scan the chosen folder, then add everything found to the end of the playlist
+		if (openFolderOpen && openFolderFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			auto folder = openFolderFuture.get();
+			if (!folder.empty()) {
+				scanFuture = std::async(std::launch::async, [folder, &library] () { return LibraryScanner::scan(folder, library); });
+				scanning = true;
+			}
+			openFolderOpen = false;
+		}
+		if (scanning && scanFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			auto found = scanFuture.get();
+			size_t firstNew = tracks.size();
+			for (auto& track : found)
+				tracks.add(track.path, track.title, (int)track.duration);
+			indexTracks(firstNew);
+			if (!found.empty()) {
+				tracks.save(currentPlaylist);
+				order.add(found.size());
+				queueNext();
+				analyseTracks(firstNew);
+			}
+			else {
+				pfd::message("Add Folder", "No music found in that folder").result();
+			}
+			scanning = false;
+		}
+
+		// The engine moves on to the queued track by itself, so just queue up the one after
+		if (music.pollTrackChanged()) {
+			order.advance();
+			queueNext();
+			showNowPlaying();
+			findBeat();
+		}
+		// The current track may only just have been analysed
+		else if (beatTempo == 0 && loudness.pollAnalysed()) {
+			findBeat();
+		}
+
+		// The stream only stops at the end of a track when the next one was not ready or
+		// has a different format, in which case it has to be opened directly
+		if (music.getStatus() == sf::SoundSource::Status::Stopped && !playlistEnded) {
+			if (order.advance())
+				playCurrent();
+			else
+				playlistEnded = true;
+		}
+
+		//printf("%s: %f / %f\n", tracks.getPath(order.current()).c_str(), music.getPlayingOffset().asSeconds(), music.getDuration().asSeconds());
+
+		// The idle frames go round once a beat while the beat of the track is known, and at
+		// their own pace otherwise. Without any idle frames the head nods on the beat instead
+		sf::Time animationElapsed = animationClock.restart();
+		float nod = 0;
+		if (beatTempo > 0 && music.getStatus() == sf::SoundSource::Status::Playing) {
+			float phase = BeatTracker::getPhase(beatTempo, beatOffset, music.getTrackOffset().asSeconds());
+			headIdle.setProgress(phase);
+			if (headIdle.getFrameCount() == 1 && phase < 0.25f)
+				nod = nodDepth;
+		}
+		else {
+			headIdle.update(animationElapsed);
+		}
+		headButton->getSprite()->setPosition(sf::Vector2f{ headX, headY + nod });
+
+		// Set transparency for anything that is not a sprite, only when the shape has changed
+		scene->setVisible(menuSprite, menuOpen);
+		for (auto b : menuButtons)
+			scene->setVisible(b, menuOpen);
+		scene->updateShape(window);
+
+		if (visualizer) {
+			spectrum.update(music, visualizerClock.restart());
+			if (spectrum.isActive()) {
+				const auto& bands = spectrum.getBands();
+				for (size_t i = 0; i < bands.size(); i++) {
+					float left = deskX + barMargin + i * (barWidth + barGap);
+					float right = left + barWidth;
+					float bottom = deskY + barMargin + barHeight;
+					float top = bottom - std::max(bands[i] * barHeight, 1.0f);
+					sf::Vector2f corners[6] = { {left, top}, {right, top}, {left, bottom}, {left, bottom}, {right, top}, {right, bottom} };
+					for (size_t j = 0; j < 6; j++) {
+						bars[i * 6 + j].position = corners[j];
+						bars[i * 6 + j].color = sf::Color(255, 214, 170, 220);
+					}
+				}
+				scene->requestRedraw();
+			}
 		}
 
-		//printf("%s: %f / %f\n", tracks[trackIndex].c_str(), music.getPlayingOffset().asSeconds(), music.getDuration().asSeconds());
-
-		// TODO: Only do this if the UI or animation changes to improve performance
-		// Set transparency for anything that is not a sprite
-		auto rt = new sf::RenderTexture({winWidth, winHeight});
-		rt->clear(sf::Color::Transparent);
-		for (const auto sprite : sprites)
-			rt->draw(*sprite);
-		for (const auto button : buttons)
-			button->draw(rt);
-		// Just include the outer menu background
-		if (menuOpen) 
-			rt->draw(*menuSprite);
-		rt->display();
-		sf::Image mask = rt->getTexture().copyToImage();
-		OSInterface::setTransparency(window, mask);
-
-		// Drawing all the sprites
-		if (desktopBuddy)
-			OSInterface::bringWindowToTop(window); // TODO: Only do this if I need to to improve performance
-		for (auto s : sprites)
-			window->draw(*s);
-		for (auto button : buttons)
-			button->draw(window);
-		if (menuOpen) {
-			window->draw(*menuSprite);
-			for (auto b : menuButtons)
-				b->draw(window);
+		// Drawing all the sprites, only when something has changed since the last frame
+		if (desktopBuddy && OSInterface::keepWindowOnTop(window))
+			scene->requestRedraw();
+		if (window->isOpen() && scene->needsRedraw()) {
+			scene->draw(window);
+			if (visualizer)
+				window->draw(bars);
+			window->display();
 		}
-		window->display();
     }
 }